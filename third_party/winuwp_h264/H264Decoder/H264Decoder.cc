@@ -19,13 +19,17 @@
 #include <robuffer.h>
 #include <wrl.h>
 #include <wrl\implements.h>
+#include <algorithm>
 #include <iomanip>
 #include "../Utils/Utils.h"
+#include "../Utils/MFDecoderTransformAllocator.h"
+#include "../Utils/MFNV12Buffer.h"
+#include "../Utils/NV12Conversion.h"
 #include "common_video/include/video_frame_buffer.h"
-#include "libyuv/convert.h"
 #include "modules/video_coding/include/video_codec_interface.h"
 #include "rtc_base/checks.h"
 #include "rtc_base/logging.h"
+#include "rtc_base/timeutils.h"
 
 #pragma comment(lib, "mfreadwrite")
 #pragma comment(lib, "mfplat")
@@ -37,8 +41,21 @@ namespace webrtc {
 // H264 WinUWP Decoder Implementation
 //////////////////////////////////////////
 
+// Input samples are rounded up so the next, slightly bigger frame still
+// fits. Output samples all have the size GetOutputStreamInfo() reports.
+static const size_t kInputSampleGranularity = 16 * 1024;
+static const size_t kMaxPooledInputSamples = 8;
+static const size_t kMaxPooledOutputSamples = 4;
+
 WinUWPH264DecoderImpl::WinUWPH264DecoderImpl()
-    : buffer_pool_(false, 300), /* max_number_of_buffers*/ 
+    : WinUWPH264DecoderImpl(nullptr) {}
+
+WinUWPH264DecoderImpl::WinUWPH264DecoderImpl(ComPtr<IMFTransform> decoder)
+    : decoder_(decoder),
+      buffer_pool_(false, 300), /* max_number_of_buffers*/ 
+      input_samples_(&input_sample_allocator_, kInputSampleGranularity,
+                     kMaxPooledInputSamples),
+      output_samples_(&output_sample_allocator_, 1, kMaxPooledOutputSamples),
       width_(absl::nullopt),
       height_(absl::nullopt),
       decode_complete_callback_(nullptr){}
@@ -107,6 +124,10 @@ int WinUWPH264DecoderImpl::InitDecode(const VideoCodec* codec_settings,
                                       int number_of_cores) {
   RTC_LOG(LS_INFO) << "WinUWPH264DecoderImpl::InitDecode()\n";
 
+  // Decoding runs on this thread, also with a transform leased from a pool
+  // that was created elsewhere.
+  MFRuntimeSession::EnsureComInitialized();
+
   width_ = codec_settings->width > 0
                ? absl::optional<UINT32>(codec_settings->width)
                : absl::nullopt;
@@ -115,12 +136,15 @@ int WinUWPH264DecoderImpl::InitDecode(const VideoCodec* codec_settings,
                 : absl::nullopt;
 
   HRESULT hr = S_OK;
-  ON_SUCCEEDED(CoInitializeEx(0, COINIT_APARTMENTTHREADED));
-  ON_SUCCEEDED(MFStartup(MF_VERSION, 0));
+  if (!runtime_.started()) {
+    RTC_LOG(LS_ERROR) << "Init failure: Media Foundation is not running.";
+    return WEBRTC_VIDEO_CODEC_ERROR;
+  }
 
-  ON_SUCCEEDED(CoCreateInstance(CLSID_MSH264DecoderMFT, nullptr,
-                                CLSCTX_INPROC_SERVER, IID_IUnknown,
-                                (void**)&decoder_));
+  // Transforms leased from a pool arrive warm and unconfigured.
+  if (decoder_ == nullptr) {
+    ON_SUCCEEDED(CreateH264DecoderTransform(&decoder_));
+  }
 
   if (FAILED(hr)) {
     RTC_LOG(LS_ERROR) << "Init failure: could not create Media Foundation H264 "
@@ -128,29 +152,6 @@ int WinUWPH264DecoderImpl::InitDecode(const VideoCodec* codec_settings,
     return WEBRTC_VIDEO_CODEC_ERROR;
   }
 
-  // Try set decoder attributes
-  ComPtr<IMFAttributes> decoder_attrs;
-  ON_SUCCEEDED(decoder_->GetAttributes(decoder_attrs.GetAddressOf()));
-
-  if (SUCCEEDED(hr)) {
-    ON_SUCCEEDED(decoder_attrs->SetUINT32(CODECAPI_AVLowLatencyMode, TRUE));
-    if (FAILED(hr)) {
-      RTC_LOG(LS_WARNING)
-          << "Init warning: failed to set low latency in H264 decoder.";
-      hr = S_OK;
-    }
-
-    ON_SUCCEEDED(
-        decoder_attrs->SetUINT32(CODECAPI_AVDecVideoAcceleration_H264, TRUE));
-    if (FAILED(hr)) {
-      RTC_LOG(LS_WARNING)
-          << "Init warning: failed to set HW accel in H264 decoder.";
-    }
-  }
-
-  // Clear any error from try set attributes
-  hr = S_OK;
-
   ComPtr<IMFMediaType> input_media;
   ON_SUCCEEDED(CreateInputMediaType(
       input_media.GetAddressOf(), width_, height_,
@@ -205,7 +206,7 @@ int WinUWPH264DecoderImpl::InitDecode(const VideoCodec* codec_settings,
 
 /**
  * Workaround [MF H264 bug: Output status is never set, even when ready]
- *  => For now, always mark "ready" (results in extra buffer alloc/dealloc).
+ *  => For now, always mark "ready" (the extra output sample is pooled).
  */
 HRESULT GetOutputStatus(ComPtr<IMFTransform> decoder, DWORD* output_status) {
   HRESULT hr = decoder->GetOutputStatus(output_status);
@@ -234,27 +235,12 @@ HRESULT WinUWPH264DecoderImpl::FlushFrames(uint32_t rtp_timestamp,
       return hr;
     }
 
-    // Create output sample
-    ComPtr<IMFMediaBuffer> out_buffer;
-    ON_SUCCEEDED(MFCreateMemoryBuffer(strm_info.cbSize, &out_buffer));
-    if (FAILED(hr)) {
-      RTC_LOG(LS_ERROR)
-          << "Decode failure: output image memory buffer creation failed.";
-      return hr;
-    }
-
-    ComPtr<IMFSample> out_sample;
-    ON_SUCCEEDED(MFCreateSample(&out_sample));
-    if (FAILED(hr)) {
-      RTC_LOG(LS_ERROR) << "Decode failure: output in_sample creation failed.";
-      return hr;
-    }
-
-    ON_SUCCEEDED(out_sample->AddBuffer(out_buffer.Get()));
-    if (FAILED(hr)) {
-      RTC_LOG(LS_ERROR)
-          << "Decode failure: failed to add buffer to output in_sample.";
-      return hr;
+    // Reuse an idle output sample; only allocates while the pool warms up
+    // or after the output size grew.
+    ComPtr<IMFSample> out_sample = output_samples_.Acquire(strm_info.cbSize);
+    if (!out_sample) {
+      RTC_LOG(LS_ERROR) << "Decode failure: output sample allocation failed.";
+      return E_OUTOFMEMORY;
     }
 
     // Create output buffer description
@@ -268,32 +254,28 @@ HRESULT WinUWPH264DecoderImpl::FlushFrames(uint32_t rtp_timestamp,
     // Note: we don't use ON_SUCCEEDED here since ProcessOutput returns
     //       MF_E_TRANSFORM_NEED_MORE_INPUT often (too many log messages).
     DWORD status;
+    const int64_t decode_start_us = rtc::TimeMicros();
     hr = decoder_->ProcessOutput(0, 1, &output_data_buffer, &status);
 
     if (FAILED(hr))
       return hr; /* can return MF_E_TRANSFORM_NEED_MORE_INPUT or
                     MF_E_TRANSFORM_STREAM_CHANGE (entirely acceptable) */
 
-    // Copy raw output sample data to video frame buffer.
-    ComPtr<IMFMediaBuffer> src_buffer;
-    ON_SUCCEEDED(out_sample->ConvertToContiguousBuffer(&src_buffer));
-    if (FAILED(hr)) {
-      RTC_LOG(LS_ERROR) << "Decode failure: failed to get contiguous buffer.";
-      return hr;
-    }
+    // The MFT decodes synchronously inside ProcessOutput().
+    pipeline_stats_.AddLatency(PipelineStats::kCodec,
+                               rtc::TimeMicros() - decode_start_us);
+    frames_in_decoder_ = std::max(frames_in_decoder_ - 1, 0);
+    pipeline_stats_.SetInFlight(frames_in_decoder_);
 
-    uint32_t width, height;
-    if (width_.has_value() && height_.has_value()) {
-      width = width_.value();
-      height = height_.value();
-    } else {
-      // Query the size from MF output media type
+    // Query the output layout once per output media type.
+    if (!output_rows_.has_value()) {
       ComPtr<IMFMediaType> output_type;
       ON_SUCCEEDED(
           decoder_->GetOutputCurrentType(0, output_type.GetAddressOf()));
 
+      uint32_t frame_width, frame_height;
       ON_SUCCEEDED(MFGetAttributeSize(output_type.Get(), MF_MT_FRAME_SIZE,
-                                      &width, &height));
+                                      &frame_width, &frame_height));
       if (FAILED(hr)) {
         RTC_LOG(LS_ERROR) << "Decode failure: could not read image dimensions "
                              "from Media Foundation, so the video frame buffer "
@@ -301,48 +283,76 @@ HRESULT WinUWPH264DecoderImpl::FlushFrames(uint32_t rtp_timestamp,
         return hr;
       }
 
-      // Update members to avoid querying unnecessarily
-      width_.emplace(width);
-      height_.emplace(height);
+      // The frame size describes the allocated surface (e.g. 1088 rows for
+      // 1080p) and the stride may be padded beyond it.
+      UINT32 default_stride;
+      if (FAILED(output_type->GetUINT32(MF_MT_DEFAULT_STRIDE,
+                                        &default_stride)) ||
+          static_cast<INT32>(default_stride) <= 0) {
+        default_stride = frame_width;
+      }
+      output_rows_.emplace(frame_height);
+      output_stride_.emplace(default_stride);
+
+      if (!width_.has_value() || !height_.has_value()) {
+        // The visible part of the surface, when the decoder reports it.
+        MFVideoArea aperture;
+        if (SUCCEEDED(output_type->GetBlob(
+                MF_MT_MINIMUM_DISPLAY_APERTURE,
+                reinterpret_cast<UINT8*>(&aperture), sizeof(aperture),
+                nullptr))) {
+          frame_width = aperture.Area.cx;
+          frame_height = aperture.Area.cy;
+        }
+
+        // Update members to avoid querying unnecessarily
+        width_.emplace(frame_width);
+        height_.emplace(frame_height);
+      }
     }
 
-    rtc::scoped_refptr<I420Buffer> buffer =
-        buffer_pool_.CreateBuffer(width, height);
-
-    if (!buffer.get()) {
-      // Pool has too many pending frames.
-      RTC_LOG(LS_WARNING) << "Decode warning: too many frames. Dropping frame.";
-      return WEBRTC_VIDEO_CODEC_NO_OUTPUT;
+    uint32_t width = width_.value();
+    uint32_t height = height_.value();
+
+    // Wrap the decoded sample; it stays locked until the frame is released.
+    rtc::scoped_refptr<MFNV12Buffer> nv12_buffer =
+        MFNV12Buffer::Create(out_sample, width, height, output_rows_.value(),
+                             output_stride_.value());
+    if (!nv12_buffer) {
+      RTC_LOG(LS_WARNING) << "Decode warning: could not map decoded sample. "
+                             "Dropping frame.";
+      pipeline_stats_.OnFrameDropped(PipelineStats::kDropBufferUnavailable);
+      continue;
     }
 
-    DWORD cur_length;
-    ON_SUCCEEDED(src_buffer->GetCurrentLength(&cur_length));
-    if (FAILED(hr)) {
-      RTC_LOG(LS_ERROR) << "Decode failure: could not get buffer length.";
-      return hr;
-    }
-
-    if (cur_length > 0) {
-      BYTE* src_data;
-      DWORD max_len, cur_len;
-      ON_SUCCEEDED(src_buffer->Lock(&src_data, &max_len, &cur_len));
-      if (FAILED(hr)) {
-        RTC_LOG(LS_ERROR) << "Decode failure: could lock buffer for copying.";
-        return hr;
+    rtc::scoped_refptr<VideoFrameBuffer> frame_buffer;
+    if (pass_through_nv12_) {
+      frame_buffer = nv12_buffer;
+    } else {
+      rtc::scoped_refptr<I420Buffer> buffer =
+          buffer_pool_.CreateBuffer(width, height);
+
+      if (!buffer.get()) {
+        // Pool has too many pending frames.
+        RTC_LOG(LS_WARNING)
+            << "Decode warning: too many frames. Dropping frame.";
+        pipeline_stats_.OnFrameDropped(PipelineStats::kDropBufferUnavailable);
+        return WEBRTC_VIDEO_CODEC_NO_OUTPUT;
       }
 
-      // Convert NV12 to I420. Y and UV sections have same stride in NV12
-      // (width). The size of the Y section is the size of the frame, since Y
-      // luminance values are 8-bits each.
-      libyuv::NV12ToI420(src_data, width, src_data + (width * height), width,
-                         buffer->MutableDataY(), buffer->StrideY(),
-                         buffer->MutableDataU(), buffer->StrideU(),
-                         buffer->MutableDataV(), buffer->StrideV(), width,
-                         height);
-
-      ON_SUCCEEDED(src_buffer->Unlock());
-      if (FAILED(hr))
-        return hr;
+      if (!conversion_workers_)
+        conversion_workers_ = CreateNV12ConversionWorkers(width, height);
+      const int64_t conversion_start_us = rtc::TimeMicros();
+      ConvertNV12ToI420(nv12_buffer->planes(), buffer->MutableDataY(),
+                        buffer->StrideY(), buffer->MutableDataU(),
+                        buffer->StrideU(), buffer->MutableDataV(),
+                        buffer->StrideV(), width, height,
+                        conversion_workers_.get());
+      pipeline_stats_.AddLatency(PipelineStats::kConversion,
+                                 rtc::TimeMicros() - conversion_start_us);
+      pipeline_stats_.AddBytesCopied(
+          NV12BufferSize(NV12Stride(width), height));
+      frame_buffer = buffer;
     }
 
     // LONGLONG sample_time; /* unused */
@@ -352,15 +362,21 @@ HRESULT WinUWPH264DecoderImpl::FlushFrames(uint32_t rtp_timestamp,
     // and use it in place of rtp_timestamp, since MF may interpolate it.
     // Instead, we ignore the MFT sample time out, using rtp from in frame that
     // triggered this decoded frame.
-    VideoFrame decoded_frame(buffer, rtp_timestamp, 0, kVideoRotation_0);
+    VideoFrame decoded_frame(frame_buffer, rtp_timestamp, 0, kVideoRotation_0);
 
     // Use ntp time from the earliest frame
     decoded_frame.set_ntp_time_ms(ntp_time_ms);
 
     // Emit image to downstream
     if (decode_complete_callback_ != nullptr) {
+      const int64_t callback_start_us = rtc::TimeMicros();
       decode_complete_callback_->Decoded(decoded_frame, absl::nullopt,
                                          absl::nullopt);
+      pipeline_stats_.AddLatency(PipelineStats::kCallback,
+                                 rtc::TimeMicros() - callback_start_us);
+      pipeline_stats_.OnFrameOut();
+    } else {
+      pipeline_stats_.OnFrameDropped(PipelineStats::kDropNoCallback);
     }
   }
 
@@ -375,14 +391,17 @@ HRESULT WinUWPH264DecoderImpl::EnqueueFrame(const EncodedImage& input_image,
                                             bool missing_frames) {
   HRESULT hr = S_OK;
 
-  // Create a MF buffer from our data
+  // Get a recycled sample large enough for our data
+  ComPtr<IMFSample> in_sample = input_samples_.Acquire(input_image._length);
+  if (!in_sample) {
+    RTC_LOG(LS_ERROR) << "Decode failure: input sample allocation failed.";
+    return E_OUTOFMEMORY;
+  }
+
   ComPtr<IMFMediaBuffer> in_buffer;
-  ON_SUCCEEDED(MFCreateMemoryBuffer(input_image._length, &in_buffer));
-  if (FAILED(hr)) {
-    RTC_LOG(LS_ERROR)
-        << "Decode failure: input image memory buffer creation failed.";
+  ON_SUCCEEDED(in_sample->GetBufferByIndex(0, &in_buffer));
+  if (FAILED(hr))
     return hr;
-  }
 
   DWORD max_len, cur_len;
   BYTE* data;
@@ -390,7 +409,11 @@ HRESULT WinUWPH264DecoderImpl::EnqueueFrame(const EncodedImage& input_image,
   if (FAILED(hr))
     return hr;
 
+  const int64_t copy_start_us = rtc::TimeMicros();
   memcpy(data, input_image._buffer, input_image._length);
+  pipeline_stats_.AddLatency(PipelineStats::kConversion,
+                             rtc::TimeMicros() - copy_start_us);
+  pipeline_stats_.AddBytesCopied(input_image._length);
 
   ON_SUCCEEDED(in_buffer->Unlock());
   if (FAILED(hr))
@@ -400,21 +423,6 @@ HRESULT WinUWPH264DecoderImpl::EnqueueFrame(const EncodedImage& input_image,
   if (FAILED(hr))
     return hr;
 
-  // Create a sample from media buffer
-  ComPtr<IMFSample> in_sample;
-  ON_SUCCEEDED(MFCreateSample(&in_sample));
-  if (FAILED(hr)) {
-    RTC_LOG(LS_ERROR) << "Decode failure: input in_sample creation failed.";
-    return hr;
-  }
-
-  ON_SUCCEEDED(in_sample->AddBuffer(in_buffer.Get()));
-  if (FAILED(hr)) {
-    RTC_LOG(LS_ERROR)
-        << "Decode failure: failed to add buffer to input in_sample.";
-    return hr;
-  }
-
   int64_t sample_time_ms;
   if (first_frame_rtp_ == 0) {
     first_frame_rtp_ = input_image.Timestamp();
@@ -459,7 +467,13 @@ HRESULT WinUWPH264DecoderImpl::EnqueueFrame(const EncodedImage& input_image,
   }
 
   // Enqueue sample with Media Foundation
+  const int64_t enqueue_start_us = rtc::TimeMicros();
   ON_SUCCEEDED(decoder_->ProcessInput(0, in_sample.Get(), 0));
+  pipeline_stats_.AddLatency(PipelineStats::kQueueing,
+                             rtc::TimeMicros() - enqueue_start_us);
+  if (SUCCEEDED(hr)) {
+    pipeline_stats_.SetInFlight(++frames_in_decoder_);
+  }
   return hr;
 }
 
@@ -481,10 +495,13 @@ int WinUWPH264DecoderImpl::Decode(const EncodedImage& input_image,
     return WEBRTC_VIDEO_CODEC_ERR_PARAMETER;
   }
 
+  pipeline_stats_.OnFrameIn();
+
   // Discard until keyframe.
   if (require_keyframe_) {
     if (input_image._frameType != kVideoFrameKey ||
         !input_image._completeFrame) {
+      pipeline_stats_.OnFrameDropped(PipelineStats::kDropWaitingForKeyFrame);
       return WEBRTC_VIDEO_CODEC_ERROR;
     } else {
       require_keyframe_ = false;
@@ -497,23 +514,30 @@ int WinUWPH264DecoderImpl::Decode(const EncodedImage& input_image,
     // For robustness (shouldn't happen). Flush any old MF data blocking the
     // new frames.
     hr = decoder_->ProcessMessage(MFT_MESSAGE_COMMAND_FLUSH, NULL);
+    pipeline_stats_.OnReinit();
+    frames_in_decoder_ = 0;
+    pipeline_stats_.SetInFlight(0);
 
     if (input_image._frameType == kVideoFrameKey) {
       ON_SUCCEEDED(EnqueueFrame(input_image, missing_frames));
     } else {
       require_keyframe_ = true;
+      pipeline_stats_.OnFrameDropped(PipelineStats::kDropCodecError);
       return WEBRTC_VIDEO_CODEC_ERROR;
     }
   }
 
-  if (FAILED(hr))
+  if (FAILED(hr)) {
+    pipeline_stats_.OnFrameDropped(PipelineStats::kDropCodecError);
     return WEBRTC_VIDEO_CODEC_ERROR;
+  }
 
   // Flush any decoded samples resulting from new frame, invoking callback
   hr = FlushFrames(input_image.Timestamp(), input_image.ntp_time_ms_);
 
   if (hr == MF_E_TRANSFORM_STREAM_CHANGE) {
     // Output media type is no longer suitable. Reconfigure and retry.
+    pipeline_stats_.OnReinit();
     bool suitable_type_found;
     hr = ConfigureOutputMediaType(decoder_, MFVideoFormat_NV12,
                                   &suitable_type_found);
@@ -526,6 +550,8 @@ int WinUWPH264DecoderImpl::Decode(const EncodedImage& input_image,
     // be manually changed too).
     width_.reset();
     height_.reset();
+    output_rows_.reset();
+    output_stride_.reset();
 
     hr = FlushFrames(input_image.Timestamp(), input_image.ntp_time_ms_);
   }
@@ -534,6 +560,7 @@ int WinUWPH264DecoderImpl::Decode(const EncodedImage& input_image,
     return WEBRTC_VIDEO_CODEC_OK;
   }
 
+  pipeline_stats_.OnFrameDropped(PipelineStats::kDropCodecError);
   return WEBRTC_VIDEO_CODEC_ERROR;
 }
 
@@ -551,23 +578,49 @@ int WinUWPH264DecoderImpl::Release() {
 
   // Release I420 frame buffer pool
   buffer_pool_.Release();
+  conversion_workers_.reset();
+
+  // Drop recycled MF samples
+  input_samples_.Clear();
+  output_samples_.Clear();
+  output_rows_.reset();
+  output_stride_.reset();
+  frames_in_decoder_ = 0;
+  pipeline_stats_.SetInFlight(0);
   
   if (decoder_ != NULL) {
     // Follow shutdown procedure gracefully. On fail, continue anyway.
     ON_SUCCEEDED(decoder_->ProcessMessage(MFT_MESSAGE_NOTIFY_END_OF_STREAM, 0));
     ON_SUCCEEDED(decoder_->ProcessMessage(MFT_MESSAGE_COMMAND_DRAIN, NULL));
     ON_SUCCEEDED(decoder_->ProcessMessage(MFT_MESSAGE_COMMAND_FLUSH, NULL));
-    decoder_ = nullptr;
+
+    // The transform is kept for a following InitDecode() or
+    // DetachTransform(), so it must not be left streaming with the old
+    // media types. One that can't be reset is replaced on the next init.
+    if (FAILED(ResetH264DecoderTransform(decoder_))) {
+      RTC_LOG(LS_WARNING) << "Could not reset the H264 decoder, dropping it.";
+      decoder_ = nullptr;
+    }
   }
 
-  MFShutdown();
-  CoUninitialize();
+  // The MF runtime stays up as long as |runtime_| is alive.
 
   return WEBRTC_VIDEO_CODEC_OK;
 }
 
+ComPtr<IMFTransform> WinUWPH264DecoderImpl::DetachTransform() {
+  RTC_DCHECK(!inited_);
+  ComPtr<IMFTransform> decoder = decoder_;
+  decoder_ = nullptr;
+  return decoder;
+}
+
 const char* WinUWPH264DecoderImpl::ImplementationName() const {
   return "H264_MediaFoundation";
 }
 
+PipelineStats::Snapshot WinUWPH264DecoderImpl::GetPipelineStats() const {
+  return pipeline_stats_.GetSnapshot();
+}
+
 }  // namespace webrtc
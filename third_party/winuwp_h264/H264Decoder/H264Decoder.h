@@ -16,7 +16,12 @@
 #include <Mfreadwrite.h>
 #include <mferror.h>
 #include <wrl.h>
+#include <memory>
 #include "../Utils/SampleAttributeQueue.h"
+#include "../Utils/MFSampleAllocator.h"
+#include "../Utils/PipelineStats.h"
+#include "../Utils/MFRuntimeSession.h"
+#include "../Utils/WorkerPool.h"
 #include "api/video_codecs/video_decoder.h"
 #include "common_video/include/i420_buffer_pool.h"
 #include "modules/video_coding/codecs/h264/include/h264.h"
@@ -33,6 +38,9 @@ namespace webrtc {
 class WinUWPH264DecoderImpl : public H264Decoder {
  public:
   WinUWPH264DecoderImpl();
+  // Uses |decoder|, e.g. a warm transform from a pool, instead of creating
+  // one in InitDecode(). May be null.
+  explicit WinUWPH264DecoderImpl(ComPtr<IMFTransform> decoder);
 
   virtual ~WinUWPH264DecoderImpl();
 
@@ -49,19 +57,43 @@ class WinUWPH264DecoderImpl : public H264Decoder {
 
   const char* ImplementationName() const override;
 
+  // Latency histograms and frame counters since construction.
+  PipelineStats::Snapshot GetPipelineStats() const;
+
+  // Hands the transform back to the caller, e.g. to return it to a pool.
+  // Only valid after Release(); the next InitDecode() creates a new one.
+  ComPtr<IMFTransform> DetachTransform();
+
  private:
   HRESULT FlushFrames(uint32_t timestamp, uint64_t ntp_time_ms);
   HRESULT EnqueueFrame(const EncodedImage& input_image, bool missing_frames);
 
  private:
+  // Declared first so the runtime outlives every MF object below.
+  MFRuntimeSession runtime_;
   ComPtr<IMFTransform> decoder_;
   I420BufferPool buffer_pool_;
+  // One allocator per pool, each routes released samples to its own pool.
+  MFSampleAllocator input_sample_allocator_;
+  MFSampleAllocator output_sample_allocator_;
+  MFSamplePool input_samples_;
+  MFSamplePool output_samples_;
 
   bool inited_ = false;
   bool require_keyframe_ = true;
   uint32_t first_frame_rtp_ = 0;
   absl::optional<uint32_t> width_;
   absl::optional<uint32_t> height_;
+  // Layout of the NV12 surfaces the decoder outputs.
+  absl::optional<uint32_t> output_rows_;
+  absl::optional<uint32_t> output_stride_;
+  // Hand decoded NV12 samples downstream instead of converting to I420.
+  bool pass_through_nv12_ = true;
+  // Started by the first frame large enough to convert in slices.
+  std::unique_ptr<WorkerPool> conversion_workers_;
+  // Frames given to the decoder that haven't come out yet.
+  int frames_in_decoder_ = 0;
+  PipelineStats pipeline_stats_;
   rtc::CriticalSection crit_;
   DecodedImageCallback* decode_complete_callback_;
 };  // end of WinUWPH264DecoderImpl class
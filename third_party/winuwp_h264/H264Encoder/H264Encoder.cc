@@ -20,6 +20,7 @@
 #include <codecapi.h>
 #include <mfreadwrite.h>
 #include <wrl\implements.h>
+#include <algorithm>
 #include <sstream>
 #include <vector>
 #include <iomanip>
@@ -27,9 +28,10 @@
 #include "H264StreamSink.h"
 #include "H264MediaSink.h"
 #include "../Utils/Utils.h"
+#include "../Utils/NV12Conversion.h"
 #include "modules/video_coding/include/video_codec_interface.h"
 #include "rtc_base/timeutils.h"
-#include "libyuv/convert.h"
+#include "third_party/winuwp_h264/native_handle_buffer.h"
 #include "rtc_base/logging.h"
 #include "rtc_base/win32.h"
 
@@ -43,11 +45,61 @@ namespace webrtc {
 // QP scaling thresholds.
 static const int kLowH264QpThreshold = 24;
 static const int kHighH264QpThreshold = 37;
+
+// Highest QP H.264 allows. VideoCodec::qpMax defaults to 56, a VP8 value.
+static const UINT32 kMaxH264Qp = 51;
+
+namespace {
+
+// Keeps an IMFMediaBuffer locked for the lifetime of the object.
+class ScopedMediaBufferLock {
+ public:
+  explicit ScopedMediaBufferLock(IMFMediaBuffer* buffer)
+    : buffer_(buffer) {
+    DWORD maxLength;
+    locked_ = SUCCEEDED(buffer_->Lock(&data_, &maxLength, &length_));
+  }
+
+  ~ScopedMediaBufferLock() {
+    Unlock();
+  }
+
+  void Unlock() {
+    if (locked_) {
+      buffer_->Unlock();
+      locked_ = false;
+    }
+  }
+
+  bool locked() const { return locked_; }
+  BYTE* data() const { return data_; }
+  DWORD length() const { return length_; }
+
+ private:
+  IMFMediaBuffer* buffer_;
+  BYTE* data_ {};
+  DWORD length_ {};
+  bool locked_ {};
+};
+
+}  // namespace
+
 //////////////////////////////////////////
 // H264 WinUWP Encoder Implementation
 //////////////////////////////////////////
 
+// Input samples stay with the sink writer until encoded; Encode() keeps at
+// most 3 in flight.
+static const size_t kMaxPooledInputSamples = 4;
+
 WinUWPH264EncoderImpl::WinUWPH264EncoderImpl()
+  : WinUWPH264EncoderImpl(false)
+{
+}
+
+WinUWPH264EncoderImpl::WinUWPH264EncoderImpl(bool copyOutputBuffers)
+  : wrapOutputBuffers_(!copyOutputBuffers),
+    inputSamples_(&sampleAllocator_, 1, kMaxPooledInputSamples)
 {
 }
 
@@ -125,6 +177,8 @@ int WinUWPH264EncoderImpl::InitEncoderWithSettings(const VideoCodec* codec_setti
   ON_SUCCEEDED(mediaTypeIn->SetUINT32(MF_MT_ALL_SAMPLES_INDEPENDENT, TRUE));
   ON_SUCCEEDED(MFSetAttributeSize(mediaTypeIn.Get(),
     MF_MT_FRAME_SIZE, width_, height_));
+  ON_SUCCEEDED(mediaTypeIn->SetUINT32(
+    MF_MT_DEFAULT_STRIDE, NV12Stride(width_)));
   ON_SUCCEEDED(MFSetAttributeRatio(mediaTypeIn.Get(),
     MF_MT_FRAME_RATE, max_frame_rate_, 1));
 
@@ -151,6 +205,11 @@ int WinUWPH264EncoderImpl::InitEncoderWithSettings(const VideoCodec* codec_setti
   ON_SUCCEEDED(MFCreateAttributes(&sinkWriterEncoderAttributes_, 1));
   ON_SUCCEEDED(sinkWriter_->SetInputMediaType(streamIndex_, mediaTypeIn.Get(), nullptr));
 
+  // The encoder exists once the input type is set.
+  if (SUCCEEDED(hr)) {
+    ConfigureCodecApi(codec_settings->qpMax);
+  }
+
   // Register this as the callback for encoded samples.
   ON_SUCCEEDED(mediaSink_->RegisterEncodingCallback(this));
 
@@ -160,7 +219,9 @@ int WinUWPH264EncoderImpl::InitEncoderWithSettings(const VideoCodec* codec_setti
 
   if (SUCCEEDED(hr)) {
     inited_ = true;
-    lastTimeSettingsChanged_ = rtc::TimeMillis();
+    ratePolicy_.set_max_bitrate_bps(max_bitrate_);
+    ratePolicy_.Reset(target_bps_, max_frame_rate_, width_, height_,
+      rtc::TimeMillis());
     return WEBRTC_VIDEO_CODEC_OK;
   } else {
     return hr;
@@ -182,6 +243,8 @@ int WinUWPH264EncoderImpl::Release() {
   {
     rtc::CritScope lock(&crit_);
     sinkWriter_.Reset();
+    dynamicBitrate_ = false;
+    dynamicFrameRate_ = false;
     if (mediaSink_ != nullptr) {
       tmpMediaSink = mediaSink_;
     }
@@ -193,8 +256,10 @@ int WinUWPH264EncoderImpl::Release() {
     firstFrame_ = true;
     inited_ = false;
     framePendingCount_ = 0;
-    _sampleAttributeQueue.clear();
+    conversionWorkers_.reset();
     rtc::CritScope callbackLock(&callbackCrit_);
+    // Cleared under the callback lock so it can't race with pop().
+    _sampleAttributeQueue.clear();
     encodedCompleteCallback_ = nullptr;
   }
 
@@ -204,25 +269,36 @@ int WinUWPH264EncoderImpl::Release() {
   return WEBRTC_VIDEO_CODEC_OK;
 }
 
-ComPtr<IMFSample> WinUWPH264EncoderImpl::FromVideoFrame(const VideoFrame& frame) {
+ComPtr<IMFSample> WinUWPH264EncoderImpl::FromVideoFrame(const VideoFrame& frame,
+  PipelineStats::DropReason* dropReason) {
   HRESULT hr = S_OK;
-  ComPtr<IMFSample> sample;
-  ON_SUCCEEDED(MFCreateSample(sample.GetAddressOf()));
+  *dropReason = PipelineStats::kDropConversionFailed;
+
+  rtc::scoped_refptr<VideoFrameBuffer> frameBuffer = frame.video_frame_buffer();
+  const int width = frameBuffer->width();
+  const int height = frameBuffer->height();
+
+  // The encoder input type is a tightly packed NV12 image, its stride
+  // rounded up to hold the chroma row of an odd width.
+  const int stride = NV12Stride(width);
+  const size_t nv12Size = NV12BufferSize(stride, height);
+  ComPtr<IMFSample> sample = inputSamples_.Acquire(nv12Size);
+  if (!sample) {
+    RTC_LOG(LS_ERROR) << "Failed to allocate an input sample.";
+    return nullptr;
+  }
 
   ComPtr<IMFAttributes> sampleAttributes;
   ON_SUCCEEDED(sample.As(&sampleAttributes));
 
-  rtc::scoped_refptr<I420BufferInterface> frameBuffer =
-      static_cast<I420BufferInterface*>(frame.video_frame_buffer().get());
+  // Set once the frame attributes are cached; without them the encoded
+  // frame could not be delivered, so the sample is not encoded at all.
+  bool queued = false;
 
-  if (SUCCEEDED(hr)) {
-    auto totalSize = frameBuffer->StrideY() * frameBuffer->height() +
-      frameBuffer->StrideU() * (frameBuffer->height() + 1) / 2 +
-      frameBuffer->StrideV() * (frameBuffer->height() + 1) / 2;
-
-    ComPtr<IMFMediaBuffer> mediaBuffer;
-    ON_SUCCEEDED(MFCreateMemoryBuffer(totalSize, mediaBuffer.GetAddressOf()));
+  ComPtr<IMFMediaBuffer> mediaBuffer;
+  ON_SUCCEEDED(sample->GetBufferByIndex(0, mediaBuffer.GetAddressOf()));
 
+  if (SUCCEEDED(hr)) {
     BYTE* destBuffer = nullptr;
     if (SUCCEEDED(hr)) {
       DWORD cbMaxLength;
@@ -232,32 +308,44 @@ ComPtr<IMFSample> WinUWPH264EncoderImpl::FromVideoFrame(const VideoFrame& frame)
     }
 
     if (SUCCEEDED(hr)) {
-      BYTE* destUV = destBuffer +
-        (frameBuffer->StrideY() * frameBuffer->height());
-      libyuv::I420ToNV12(
-        frameBuffer->DataY(), frameBuffer->StrideY(),
-        frameBuffer->DataU(), frameBuffer->StrideU(),
-        frameBuffer->DataV(), frameBuffer->StrideV(),
-        destBuffer, frameBuffer->StrideY(),
-        destUV, frameBuffer->StrideY(),
-        frameBuffer->width(),
-        frameBuffer->height());
-    }
+      const int64_t conversionStartUs = rtc::TimeMicros();
+      NV12Planes dest = {
+        destBuffer, stride, destBuffer + stride * height, stride };
+      const NV12NativeBuffer* nv12Buffer = nullptr;
+      if (frameBuffer->type() == VideoFrameBuffer::Type::kNative) {
+        nv12Buffer =
+          static_cast<NativeHandleBuffer*>(frameBuffer.get())->AsNV12();
+      }
 
-    {
-      if (frameBuffer->width() != (int)width_ || frameBuffer->height() != (int)height_) {
-        EncodedImageCallback* tempCallback = encodedCompleteCallback_;
-        Release();
-        {
-          rtc::CritScope lock(&callbackCrit_);
-          encodedCompleteCallback_ = tempCallback;
-        }
-
-        width_ = frameBuffer->width();
-        height_ = frameBuffer->height();
-        InitEncoderWithSettings(&codec_);
-        RTC_LOG(LS_WARNING) << "Resolution changed to: " << frameBuffer->width() << "x" << frameBuffer->height();
+      if (nv12Buffer != nullptr) {
+        // Already NV12, but the source sample can't be handed over: it
+        // stays locked while the frame buffer lives, its chroma plane may
+        // start below |height| rows, and other sinks share it while the
+        // encoder would stamp its sample time.
+        CopyNV12(nv12Buffer->planes(), dest, width, height);
+      } else {
+        rtc::scoped_refptr<I420BufferInterface> i420Buffer =
+          frameBuffer->ToI420();
+        if (!conversionWorkers_)
+          conversionWorkers_ = CreateNV12ConversionWorkers(width, height);
+        ConvertI420ToNV12(
+          i420Buffer->DataY(), i420Buffer->StrideY(),
+          i420Buffer->DataU(), i420Buffer->StrideU(),
+          i420Buffer->DataV(), i420Buffer->StrideV(),
+          dest, width, height, conversionWorkers_.get());
       }
+      pipelineStats_.AddLatency(PipelineStats::kConversion,
+        rtc::TimeMicros() - conversionStartUs);
+      pipelineStats_.AddBytesCopied(nv12Size);
+    }
+
+    // The only change the running pipeline can't absorb.
+    if (ratePolicy_.NeedsReinit(width, height)) {
+      width_ = width;
+      height_ = height;
+      target_bps_ = ratePolicy_.bitrate_bps();
+      ReinitEncoder();
+      RTC_LOG(LS_WARNING) << "Resolution changed to: " << width << "x" << height;
     }
 
     if (firstFrame_) {
@@ -274,8 +362,6 @@ ComPtr<IMFSample> WinUWPH264EncoderImpl::FromVideoFrame(const VideoFrame& frame)
     }
 
     if (SUCCEEDED(hr)) {
-      lastTimestampHns_ = timestampHns;
-
       // Cache the frame attributes to get them back after the encoding.
       CachedFrameAttributes frameAttributes;
       frameAttributes.timestamp = frame.timestamp();
@@ -283,24 +369,34 @@ ComPtr<IMFSample> WinUWPH264EncoderImpl::FromVideoFrame(const VideoFrame& frame)
       frameAttributes.captureRenderTime = frame.render_time_ms();
       frameAttributes.frameWidth = frame.width();
       frameAttributes.frameHeight = frame.height();
-      _sampleAttributeQueue.push(timestampHns, frameAttributes);
+      frameAttributes.submitTimeUs = rtc::TimeMicros();
+      queued = _sampleAttributeQueue.push(timestampHns, frameAttributes);
+      if (queued) {
+        lastTimestampHns_ = timestampHns;
+        pipelineStats_.SetInFlight(
+          static_cast<int>(_sampleAttributeQueue.size()));
+      } else {
+        RTC_LOG(LS_WARNING) << "Sample attribute queue full, dropping frame.";
+        *dropReason = PipelineStats::kDropAttributeQueueFull;
+        lastFrameDropped_ = true;
+      }
     }
 
-    ON_SUCCEEDED(mediaBuffer->SetCurrentLength(
-      frameBuffer->width() * frameBuffer->height() * 3 / 2));
+    ON_SUCCEEDED(mediaBuffer->SetCurrentLength(static_cast<DWORD>(nv12Size)));
 
     if (destBuffer != nullptr) {
       mediaBuffer->Unlock();
     }
 
-    ON_SUCCEEDED(sample->AddBuffer(mediaBuffer.Get()));
-
-    if (lastFrameDropped_) {
+    if (queued && lastFrameDropped_) {
       lastFrameDropped_ = false;
       sampleAttributes->SetUINT32(MFSampleExtension_Discontinuity, TRUE);
     }
   }
 
+  if (!queued) {
+    return nullptr;
+  }
   return sample;
 }
 
@@ -314,6 +410,7 @@ int WinUWPH264EncoderImpl::Encode(
       return -1;
     }
   }
+  pipelineStats_.OnFrameIn();
 
 
   if (frame_types != nullptr) {
@@ -336,15 +433,37 @@ int WinUWPH264EncoderImpl::Encode(
   codecSpecificInfo_ = codec_specific_info;
 
   ComPtr<IMFSample> sample;
+  PipelineStats::DropReason dropReason;
   {
     rtc::CritScope lock(&crit_);
+    // A bitrate increase deferred by the rate policy is stepped per frame,
+    // so it completes even if SetRates() isn't called again.
+    if (ratePolicy_.increase_pending()) {
+      ApplyRateUpdate(ratePolicy_.Poll(rtc::TimeMillis()));
+    }
     if (_sampleAttributeQueue.size() > 2) {
+      pipelineStats_.OnFrameDropped(PipelineStats::kDropPendingLimit);
       return WEBRTC_VIDEO_CODEC_OK;
     }
-    sample = FromVideoFrame(frame);
+    sample = FromVideoFrame(frame, &dropReason);
   }
 
+  if (sample == nullptr) {
+    pipelineStats_.OnFrameDropped(dropReason);
+    // A full attribute queue is back pressure like the pending limit above,
+    // not an encoder failure.
+    return dropReason == PipelineStats::kDropAttributeQueueFull
+      ? WEBRTC_VIDEO_CODEC_OK : WEBRTC_VIDEO_CODEC_ERROR;
+  }
+
+  // WriteSample() blocks while the sink writer's queue is full.
+  const int64_t writeStartUs = rtc::TimeMicros();
   ON_SUCCEEDED(sinkWriter_->WriteSample(streamIndex_, sample.Get()));
+  pipelineStats_.AddLatency(PipelineStats::kQueueing,
+    rtc::TimeMicros() - writeStartUs);
+  if (FAILED(hr)) {
+    pipelineStats_.OnFrameDropped(PipelineStats::kDropCodecError);
+  }
 
   rtc::CritScope lock(&crit_);
   // Some threads online mention this is useful to do regularly.
@@ -358,6 +477,7 @@ int WinUWPH264EncoderImpl::Encode(
 }
 
 void WinUWPH264EncoderImpl::OnH264Encoded(ComPtr<IMFSample> sample) {
+  const int64_t outputTimeUs = rtc::TimeMicros();
   DWORD totalLength;
   HRESULT hr = S_OK;
   ON_SUCCEEDED(sample->GetTotalLength(&totalLength));
@@ -366,28 +486,31 @@ void WinUWPH264EncoderImpl::OnH264Encoded(ComPtr<IMFSample> sample) {
   hr = sample->GetBufferByIndex(0, &buffer);
 
   if (SUCCEEDED(hr)) {
-    BYTE* byteBuffer;
-    DWORD maxLength;
-    DWORD curLength;
-    hr = buffer->Lock(&byteBuffer, &maxLength, &curLength);
-    if (FAILED(hr)) {
+    ScopedMediaBufferLock bufferLock(buffer.Get());
+    if (!bufferLock.locked()) {
       return;
     }
+    DWORD curLength = bufferLock.length();
     if (curLength == 0) {
       RTC_LOG(LS_WARNING) << "Got empty sample.";
-      buffer->Unlock();
+      pipelineStats_.OnFrameDropped(PipelineStats::kDropEmptyOutput);
       return;
     }
-    std::vector<byte> sendBuffer;
-    sendBuffer.resize(curLength);
-    memcpy(sendBuffer.data(), byteBuffer, curLength);
-    hr = buffer->Unlock();
-    if (FAILED(hr)) {
-      return;
+
+    // OnEncodedImage() consumes the payload before returning, so the locked
+    // media buffer can be handed out directly. Otherwise copy it into a
+    // recycled buffer and give the media buffer back right away.
+    uint8_t* payload = bufferLock.data();
+    EncodedBufferPool::Buffer pooledBuffer;
+    if (!wrapOutputBuffers_) {
+      pooledBuffer = outputBufferPool_.CopyFrom(payload, curLength);
+      pipelineStats_.AddBytesCopied(curLength);
+      bufferLock.Unlock();
+      payload = pooledBuffer.data();
     }
 
-    // sendBuffer is not copied here.
-    EncodedImage encodedImage(sendBuffer.data(), curLength, curLength);
+    // payload is not copied here.
+    EncodedImage encodedImage(payload, curLength, curLength);
 
     ComPtr<IMFAttributes> sampleAttributes;
     hr = sample.As(&sampleAttributes);
@@ -402,52 +525,39 @@ void WinUWPH264EncoderImpl::OnH264Encoded(ComPtr<IMFSample> sample) {
     }
 
     // Scan for and create mark all fragments.
-    RTPFragmentationHeader fragmentationHeader;
-    uint32_t fragIdx = 0;
-    for (uint32_t i = 0; i < sendBuffer.size() - 5; ++i) {
-      byte* ptr = sendBuffer.data() + i;
-      int prefixLengthFound = 0;
-      if (ptr[0] == 0x00 && ptr[1] == 0x00 && ptr[2] == 0x00 && ptr[3] == 0x01
-        && ((ptr[4] & 0x1f) != 0x09 /* ignore access unit delimiters */)) {
-        prefixLengthFound = 4;
-      } else if (ptr[0] == 0x00 && ptr[1] == 0x00 && ptr[2] == 0x01
-        && ((ptr[3] & 0x1f) != 0x09 /* ignore access unit delimiters */)) {
-        prefixLengthFound = 3;
-      }
+    ScanNalUnits(payload, curLength, &nalUnits_);
 
-      // Found a key frame, mark is as such in case
-      // MFSampleExtension_CleanPoint wasn't set on the sample.
-      if (prefixLengthFound > 0 && (ptr[prefixLengthFound] & 0x1f) == 0x05) {
-        encodedImage._completeFrame = true;
-        encodedImage._frameType = kVideoFrameKey;
-      }
+    // Found a key frame, mark is as such in case
+    // MFSampleExtension_CleanPoint wasn't set on the sample.
+    if (nalUnits_.has_idr) {
+      encodedImage._completeFrame = true;
+      encodedImage._frameType = kVideoFrameKey;
+    }
+
+    // The quality scaler can only adapt the resolution with a QP.
+    qpParser_.ParseFrame(payload, nalUnits_);
+    int qp;
+    if (qpParser_.GetFrameQp(&qp)) {
+      encodedImage.qp_ = qp;
+    }
 
-      if (prefixLengthFound > 0) {
-        fragmentationHeader.VerifyAndAllocateFragmentationHeader(fragIdx + 1);
-        fragmentationHeader.fragmentationOffset[fragIdx] = i + prefixLengthFound;
-        fragmentationHeader.fragmentationLength[fragIdx] = 0;  // We'll set that later
-        // Set the length of the previous fragment.
-        if (fragIdx > 0) {
-          fragmentationHeader.fragmentationLength[fragIdx - 1] =
-            i - fragmentationHeader.fragmentationOffset[fragIdx - 1];
-        }
+    RTPFragmentationHeader fragmentationHeader;
+    const std::vector<NalUnit>& units = nalUnits_.units;
+    if (!units.empty()) {
+      fragmentationHeader.VerifyAndAllocateFragmentationHeader(units.size());
+      for (size_t fragIdx = 0; fragIdx < units.size(); ++fragIdx) {
+        fragmentationHeader.fragmentationOffset[fragIdx] = units[fragIdx].offset;
+        fragmentationHeader.fragmentationLength[fragIdx] = units[fragIdx].length;
         fragmentationHeader.fragmentationPlType[fragIdx] = 0;
         fragmentationHeader.fragmentationTimeDiff[fragIdx] = 0;
-        ++fragIdx;
-        i += 5;
       }
     }
-    // Set the length of the last fragment.
-    if (fragIdx > 0) {
-      fragmentationHeader.fragmentationLength[fragIdx - 1] =
-        sendBuffer.size() -
-        fragmentationHeader.fragmentationOffset[fragIdx - 1];
-    }
 
     {
       rtc::CritScope lock(&callbackCrit_);
       --framePendingCount_;
       if (encodedCompleteCallback_ == nullptr) {
+        pipelineStats_.OnFrameDropped(PipelineStats::kDropNoCallback);
         return;
       }
 
@@ -461,10 +571,15 @@ void WinUWPH264EncoderImpl::OnH264Encoded(ComPtr<IMFSample> sample) {
         encodedImage.capture_time_ms_ = frameAttributes.captureRenderTime;
         encodedImage._encodedWidth = frameAttributes.frameWidth;
         encodedImage._encodedHeight = frameAttributes.frameHeight;
+        pipelineStats_.AddLatency(PipelineStats::kCodec,
+          outputTimeUs - frameAttributes.submitTimeUs);
+        pipelineStats_.SetInFlight(
+          static_cast<int>(_sampleAttributeQueue.size()));
       }
       else {
         // No point in confusing the callback with a frame that doesn't
         // have correct attributes.
+        pipelineStats_.OnFrameDropped(PipelineStats::kDropMissingAttributes);
         return;
       }
 
@@ -472,8 +587,12 @@ void WinUWPH264EncoderImpl::OnH264Encoded(ComPtr<IMFSample> sample) {
 		CodecSpecificInfo codecSpecificInfo;
 		codecSpecificInfo.codecType = webrtc::kVideoCodecH264;
 		codecSpecificInfo.codecSpecific.H264.packetization_mode = H264PacketizationMode::NonInterleaved;
+		const int64_t callbackStartUs = rtc::TimeMicros();
 		encodedCompleteCallback_->OnEncodedImage(
 		  encodedImage, &codecSpecificInfo, &fragmentationHeader);
+		pipelineStats_.AddLatency(PipelineStats::kCallback,
+		  rtc::TimeMicros() - callbackStartUs);
+		pipelineStats_.OnFrameOut();
 	  }
     }
   }
@@ -484,64 +603,127 @@ int WinUWPH264EncoderImpl::SetChannelParameters(
   return WEBRTC_VIDEO_CODEC_OK;
 }
 
-#define DYNAMIC_FPS
-#define DYNAMIC_BITRATE
-
 int WinUWPH264EncoderImpl::SetRates(
   uint32_t new_bitrate_kbit, uint32_t new_framerate) {
   RTC_LOG(LS_INFO) << "WinUWPH264EncoderImpl::SetRates("
     << new_bitrate_kbit << "kbit " << new_framerate << "fps)";
 
-  // This may happen.  Ignore it.
-  if (new_framerate == 0) {
-    return WEBRTC_VIDEO_CODEC_OK;
-  }
-
   rtc::CritScope lock(&crit_);
   if (sinkWriter_ == nullptr) {
     return WEBRTC_VIDEO_CODEC_UNINITIALIZED;
   }
 
-  bool bitrateUpdated = false;
-  bool fpsUpdated = false;
+  // A paused stream gets 0 kbps, the policy keeps the last target then.
+  ApplyRateUpdate(ratePolicy_.OnRates(
+    new_bitrate_kbit * 1000, new_framerate, rtc::TimeMillis()));
+  return WEBRTC_VIDEO_CODEC_OK;
+}
 
-#ifdef DYNAMIC_BITRATE
-  if (target_bps_ != (new_bitrate_kbit * 1000)) {
-    target_bps_ = new_bitrate_kbit * 1000;
-    bitrateUpdated = true;
+void WinUWPH264EncoderImpl::ApplyRateUpdate(
+  const EncoderRatePolicy::Update& update) {
+  if (!update.changed) {
+    return;
   }
-#endif
 
-#ifdef DYNAMIC_FPS
-  // Fps changes seems to be expensive, make it granular to several frames per second.
-  if (max_frame_rate_ != new_framerate && std::abs((int)max_frame_rate_ - (int)new_framerate) > 5) {
-    max_frame_rate_ = new_framerate;
-    fpsUpdated = true;
+  // Picked up whenever the pipeline has to be recreated.
+  target_bps_ = ratePolicy_.bitrate_bps();
+  const UINT32 frameRate =
+    update.framerate_changed ? ratePolicy_.framerate() : 0;
+
+  // PlaceEncodingParameters() only queues the values, its result doesn't
+  // tell whether the encoder takes them; ConfigureCodecApi() asked.
+  const bool inPlace =
+    dynamicBitrate_ && (frameRate == 0 || dynamicFrameRate_);
+  if (inPlace && SUCCEEDED(UpdateEncoderRates(target_bps_, frameRate))) {
+    if (frameRate > 0) {
+      max_frame_rate_ = frameRate;
+    }
+  } else {
+    // Rebuild the pipeline with the new settings instead.
+    RTC_LOG(LS_INFO) << "Encoder can't change rates in place, reinitializing.";
+    max_frame_rate_ = ratePolicy_.framerate();
+    ReinitEncoder();
   }
-#endif
+}
 
-  if (bitrateUpdated || fpsUpdated) {
-    if ((rtc::TimeMillis() - lastTimeSettingsChanged_) < 15000) {
-      RTC_LOG(LS_INFO) << "Last time settings changed was too soon, skipping this SetRates().\n";
-      return WEBRTC_VIDEO_CODEC_OK;
-    }
+void WinUWPH264EncoderImpl::ConfigureCodecApi(UINT32 qpMax) {
+  dynamicBitrate_ = false;
+  dynamicFrameRate_ = false;
 
-    EncodedImageCallback* tempCallback = encodedCompleteCallback_;
-    Release();
-    {
-      rtc::CritScope lock(&callbackCrit_);
-      encodedCompleteCallback_ = tempCallback;
+  ComPtr<ICodecAPI> codecApi;
+  HRESULT hr = sinkWriter_->GetServiceForStream(
+    streamIndex_, GUID_NULL, IID_PPV_ARGS(&codecApi));
+  if (FAILED(hr)) {
+    RTC_LOG(LS_INFO) << "Encoder has no ICodecAPI, rate changes reinitialize.";
+    return;
+  }
+  dynamicBitrate_ =
+    codecApi->IsModifiable(&CODECAPI_AVEncCommonMeanBitRate) == S_OK;
+  dynamicFrameRate_ =
+    codecApi->IsModifiable(&CODECAPI_AVEncVideoOutputFrameRate) == S_OK;
+
+  if (qpMax > 0) {
+    VARIANT value;
+    VariantInit(&value);
+    value.vt = VT_UI4;
+    value.ulVal = std::min(qpMax, kMaxH264Qp);
+    if (FAILED(codecApi->SetValue(&CODECAPI_AVEncVideoMaxQP, &value))) {
+      RTC_LOG(LS_INFO) << "Encoder did not take the maximum QP.";
     }
-    InitEncoderWithSettings(&codec_);
   }
+}
 
-  return WEBRTC_VIDEO_CODEC_OK;
+HRESULT WinUWPH264EncoderImpl::UpdateEncoderRates(
+  UINT32 meanBitrateBps, UINT32 frameRate) {
+  HRESULT hr = S_OK;
+  ComPtr<IMFSinkWriterEncoderConfig> encoderConfig;
+  ON_SUCCEEDED(sinkWriter_.As(&encoderConfig));
+
+  ComPtr<IMFAttributes> rateAttributes;
+  ON_SUCCEEDED(MFCreateAttributes(&rateAttributes, 2));
+  ON_SUCCEEDED(rateAttributes->SetUINT32(
+    CODECAPI_AVEncCommonMeanBitRate, meanBitrateBps));
+  if (frameRate > 0) {
+    // Packed like MF_MT_FRAME_RATE: numerator in the upper 32 bits.
+    ON_SUCCEEDED(rateAttributes->SetUINT64(
+      CODECAPI_AVEncVideoOutputFrameRate, Pack2UINT32AsUINT64(frameRate, 1)));
+  }
+  // Applied by the encoder starting with the next sample written.
+  ON_SUCCEEDED(encoderConfig->PlaceEncodingParameters(
+    streamIndex_, rateAttributes.Get()));
+  return hr;
+}
+
+int WinUWPH264EncoderImpl::ReinitEncoder() {
+  pipelineStats_.OnReinit();
+  // The new pipeline starts at |target_bps_|; an increase still ramping
+  // towards a higher estimate carries over.
+  const uint32_t pendingTargetBps = ratePolicy_.target_bitrate_bps();
+  EncodedImageCallback* tempCallback = encodedCompleteCallback_;
+  Release();
+  {
+    rtc::CritScope lock(&callbackCrit_);
+    encodedCompleteCallback_ = tempCallback;
+  }
+  int result = InitEncoderWithSettings(&codec_);
+  if (result == WEBRTC_VIDEO_CODEC_OK) {
+    ratePolicy_.RestoreTarget(pendingTargetBps);
+  }
+  return result;
 }
 
 VideoEncoder::ScalingSettings WinUWPH264EncoderImpl::GetScalingSettings() const {
   return ScalingSettings(kLowH264QpThreshold, kHighH264QpThreshold);
 }
 
+EncodedBufferPool::Stats WinUWPH264EncoderImpl::GetOutputBufferStats() const {
+  return outputBufferPool_.GetStats();
+}
+
+PipelineStats::Snapshot WinUWPH264EncoderImpl::GetPipelineStats() const {
+  return pipelineStats_.GetSnapshot();
+}
+
 const char* WinUWPH264EncoderImpl::ImplementationName() const {
   return "H264_MediaFoundation";
 }
@@ -15,10 +15,19 @@
 #include <mfidl.h>
 #include <Mfreadwrite.h>
 #include <mferror.h>
+#include <strmif.h>
+#include <memory>
 #include <vector>
 #include "H264MediaSink.h"
 #include "IH264EncodingCallback.h"
-#include "../Utils/SampleAttributeQueue.h"
+#include "../Utils/SpscSampleAttributeQueue.h"
+#include "../Utils/NalUnitScanner.h"
+#include "../Utils/EncodedBufferPool.h"
+#include "../Utils/MFSampleAllocator.h"
+#include "../Utils/EncoderRatePolicy.h"
+#include "../Utils/PipelineStats.h"
+#include "../Utils/H264QpParser.h"
+#include "../Utils/WorkerPool.h"
 #include "api/video_codecs/video_encoder.h"
 #include "rtc_base/criticalsection.h"
 #include "modules/video_coding/utility/quality_scaler.h"
@@ -35,6 +44,11 @@ class H264MediaSink;
 class WinUWPH264EncoderImpl : public VideoEncoder, public IH264EncodingCallback {
  public:
   WinUWPH264EncoderImpl();
+  // With |copyOutputBuffers| every encoded frame is copied into a recycled
+  // buffer and the Media Foundation buffer is released before the encode
+  // callback runs. Use it when the callback keeps the payload around after
+  // OnEncodedImage() returns.
+  explicit WinUWPH264EncoderImpl(bool copyOutputBuffers);
 
   ~WinUWPH264EncoderImpl();
 
@@ -54,9 +68,27 @@ class WinUWPH264EncoderImpl : public VideoEncoder, public IH264EncodingCallback
   // === IH264EncodingCallback overrides ===
   void OnH264Encoded(ComPtr<IMFSample> sample) override;
 
+  // Allocation and copy counters of the encoded output path.
+  EncodedBufferPool::Stats GetOutputBufferStats() const;
+
+  // Latency histograms and frame counters since construction.
+  PipelineStats::Snapshot GetPipelineStats() const;
+
  private:
-  ComPtr<IMFSample> FromVideoFrame(const VideoFrame& frame);
+  // Returns null and sets |dropReason| when the frame can't be encoded.
+  ComPtr<IMFSample> FromVideoFrame(const VideoFrame& frame,
+    PipelineStats::DropReason* dropReason);
   int InitEncoderWithSettings(const VideoCodec* codec_settings);
+  // Tears the pipeline down and builds it again from |codec_|.
+  int ReinitEncoder();
+  // Programs a rate policy update, reinitializing if the encoder can't
+  // change the rates while running. Called with |crit_| held.
+  void ApplyRateUpdate(const EncoderRatePolicy::Update& update);
+  // Asks the encoder which rates it can change while running and sets the
+  // maximum QP, clamped to what H.264 allows. Best effort.
+  void ConfigureCodecApi(UINT32 qpMax);
+  // Queues bitrate and frame rate (unless 0) for the running encoder.
+  HRESULT UpdateEncoderRates(UINT32 meanBitrateBps, UINT32 frameRate);
 
  private:
   rtc::CriticalSection crit_;
@@ -69,6 +101,9 @@ class WinUWPH264EncoderImpl : public VideoEncoder, public IH264EncodingCallback
   ComPtr<H264MediaSink> mediaSink_;
   EncodedImageCallback* encodedCompleteCallback_ {};
   DWORD streamIndex_ {};
+  // Whether the encoder changes these in place, see ConfigureCodecApi().
+  bool dynamicBitrate_ {};
+  bool dynamicFrameRate_ {};
   LONGLONG startTime_ {};
   LONGLONG lastTimestampHns_ {};
   bool firstFrame_ {true};
@@ -93,7 +128,8 @@ class WinUWPH264EncoderImpl : public VideoEncoder, public IH264EncodingCallback
   bool frame_dropping_on_;
   int key_frame_interval_;
 
-  int64_t lastTimeSettingsChanged_ {};
+  // Decides how SetRates() and frame size changes reach the encoder.
+  EncoderRatePolicy ratePolicy_;
 
   struct CachedFrameAttributes {
     uint32_t timestamp;
@@ -101,8 +137,32 @@ class WinUWPH264EncoderImpl : public VideoEncoder, public IH264EncodingCallback
     uint64_t captureRenderTime;
     uint32_t frameWidth;
     uint32_t frameHeight;
+    // rtc::TimeMicros() when the sample was handed to the sink writer.
+    int64_t submitTimeUs;
   };
-  SampleAttributeQueue<CachedFrameAttributes> _sampleAttributeQueue;
+  // Pushed by Encode(), popped by OnH264Encoded() on the MF work queue.
+  // Encode() keeps at most 3 frames in flight, 8 slots leave headroom.
+  SpscSampleAttributeQueue<CachedFrameAttributes, 8> _sampleAttributeQueue;
+
+  // Reused by OnH264Encoded() so the fragment table keeps its capacity.
+  // Only touched from the stream sink callback, which is serialized.
+  NalUnitScanResult nalUnits_;
+  // Reads the slice QP from those units, same thread as |nalUnits_|.
+  H264QpParser qpParser_;
+
+  // When set, encoded samples are passed to the callback straight from the
+  // locked media buffer; otherwise they are copied into |outputBufferPool_|.
+  const bool wrapOutputBuffers_;
+  EncodedBufferPool outputBufferPool_;
+
+  // Recycled NV12 input samples. Acquired in FromVideoFrame(), they come
+  // back to the pool once the sink writer releases them.
+  MFSampleAllocator sampleAllocator_;
+  MFSamplePool inputSamples_;
+  // Started by the first frame large enough to convert in slices.
+  std::unique_ptr<WorkerPool> conversionWorkers_;
+
+  PipelineStats pipelineStats_;
 
   // Caching the codec received in InitEncode().
   VideoCodec codec_;
@@ -0,0 +1,378 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#include "third_party/winuwp_h264/H264Encoder/H264SimulcastEncoder.h"
+
+#include <algorithm>
+
+#include "modules/video_coding/include/video_codec_interface.h"
+#include "rtc_base/logging.h"
+
+namespace webrtc {
+
+namespace {
+
+size_t NumberOfLayers(const VideoCodec& codec) {
+  return codec.numberOfSimulcastStreams > 1 ? codec.numberOfSimulcastStreams
+                                            : 1;
+}
+
+// Splits |total_kbit| the way the simulcast rate allocator does: each
+// layer in turn gets its target bitrate and the highest layer reached
+// gets what is left, up to its maximum. Layers that can't get their
+// minimum get nothing.
+std::vector<uint32_t> AllocateLayerBitrates(const VideoCodec& codec,
+                                            uint32_t total_kbit) {
+  const size_t numLayers = NumberOfLayers(codec);
+  std::vector<uint32_t> bitrates(numLayers, 0);
+  if (numLayers == 1) {
+    bitrates[0] = total_kbit;
+    return bitrates;
+  }
+
+  uint32_t left = total_kbit;
+  size_t top = 0;
+  for (size_t i = 0; i < numLayers; ++i) {
+    const SimulcastStream& stream = codec.simulcastStream[i];
+    // The lowest layer is always sent.
+    if (i > 0 && left < stream.minBitrate)
+      break;
+    bitrates[i] = std::min(stream.targetBitrate, left);
+    left -= bitrates[i];
+    top = i;
+  }
+  const uint32_t topMax = codec.simulcastStream[top].maxBitrate;
+  if (topMax > bitrates[top])
+    bitrates[top] += std::min(left, topMax - bitrates[top]);
+  return bitrates;
+}
+
+// Settings of the encoder driving simulcast stream |layer|.
+VideoCodec LayerCodec(const VideoCodec& codec, size_t layer,
+                      uint32_t start_kbit) {
+  VideoCodec layerCodec = codec;
+  if (NumberOfLayers(codec) == 1)
+    return layerCodec;
+
+  const SimulcastStream& stream = codec.simulcastStream[layer];
+  layerCodec.numberOfSimulcastStreams = 0;
+  layerCodec.width = stream.width;
+  layerCodec.height = stream.height;
+  layerCodec.minBitrate = stream.minBitrate;
+  layerCodec.maxBitrate = stream.maxBitrate;
+  layerCodec.qpMax = stream.qpMax;
+  // Paused layers still need a sensible rate to set up the encoder.
+  layerCodec.startBitrate = start_kbit > 0 ? start_kbit : stream.targetBitrate;
+  layerCodec.targetBitrate = layerCodec.startBitrate;
+  if (stream.maxFramerate > 0) {
+    layerCodec.maxFramerate = std::min(
+      codec.maxFramerate, static_cast<uint32_t>(stream.maxFramerate));
+  }
+  return layerCodec;
+}
+
+}  // namespace
+
+EncodedImageCallback::Result
+WinUWPH264SimulcastEncoder::LayerCallback::OnEncodedImage(
+  const EncodedImage& encoded_image,
+  const CodecSpecificInfo* codec_specific_info,
+  const RTPFragmentationHeader* fragmentation) {
+  return parent_->OnLayerEncoded(
+    layer_, encoded_image, codec_specific_info, fragmentation);
+}
+
+WinUWPH264SimulcastEncoder::WinUWPH264SimulcastEncoder()
+  : WinUWPH264SimulcastEncoder(false) {}
+
+WinUWPH264SimulcastEncoder::WinUWPH264SimulcastEncoder(bool copyOutputBuffers)
+  : copyOutputBuffers_(copyOutputBuffers) {}
+
+WinUWPH264SimulcastEncoder::~WinUWPH264SimulcastEncoder() {
+  Release();
+}
+
+int WinUWPH264SimulcastEncoder::InitEncode(const VideoCodec* codec_settings,
+  int number_of_cores,
+  size_t max_payload_size) {
+  if (!codec_settings || codec_settings->codecType != kVideoCodecH264) {
+    RTC_LOG(LS_ERROR) << "H264 UWP Encoder not registered as H264 codec";
+    return WEBRTC_VIDEO_CODEC_ERR_PARAMETER;
+  }
+
+  Release();
+  codec_ = *codec_settings;
+  numberOfCores_ = std::max(number_of_cores, 1);
+
+  const size_t numLayers = NumberOfLayers(codec_);
+  const std::vector<uint32_t> startBitrates =
+    AllocateLayerBitrates(codec_, codec_.startBitrate);
+
+  std::vector<ScalePyramid::Level> levels;
+  std::vector<uint32_t> framerates;
+  for (size_t i = 0; i < numLayers; ++i) {
+    Layer layer;
+    layer.codec = LayerCodec(codec_, i, startBitrates[i]);
+    layer.encoder.reset(new WinUWPH264EncoderImpl(copyOutputBuffers_));
+    layer.callback.reset(new LayerCallback(this, i));
+
+    int result = layer.encoder->InitEncode(
+      &layer.codec, number_of_cores, max_payload_size);
+    if (result != WEBRTC_VIDEO_CODEC_OK) {
+      RTC_LOG(LS_ERROR) << "Failed to initialize simulcast layer " << i;
+      Release();
+      return result;
+    }
+    if (numLayers > 1) {
+      layer.encoder->RegisterEncodeCompleteCallback(layer.callback.get());
+    } else {
+      // Nothing to tag, the output goes straight to the caller.
+      rtc::CritScope callbackLock(&callbackCrit_);
+      layer.encoder->RegisterEncodeCompleteCallback(encodedCompleteCallback_);
+    }
+
+    levels.push_back({ static_cast<int>(layer.codec.width),
+                       static_cast<int>(layer.codec.height) });
+    // The layer encoders pace themselves when they are alone.
+    framerates.push_back(numLayers > 1 ? layer.codec.maxFramerate : 0);
+    rtc::CritScope lock(&layersCrit_);
+    layers_.push_back(std::move(layer));
+  }
+
+  // The encoder thread takes a layer itself.
+  const size_t workers =
+    std::min(numLayers, static_cast<size_t>(numberOfCores_)) - 1;
+  if (workers > 0) {
+    layerWorkers_.reset(new WorkerPool(workers));
+  }
+
+  pyramid_.Configure(levels);
+  scheduler_.Configure(framerates);
+  if (numLayers > 1) {
+    for (size_t i = 0; i < numLayers; ++i)
+      scheduler_.SetLayerActive(i, startBitrates[i] > 0);
+  }
+  return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int WinUWPH264SimulcastEncoder::RegisterEncodeCompleteCallback(
+  EncodedImageCallback* callback) {
+  rtc::CritScope lock(&callbackCrit_);
+  encodedCompleteCallback_ = callback;
+  if (layers_.size() == 1) {
+    layers_[0].encoder->RegisterEncodeCompleteCallback(callback);
+  }
+  return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int WinUWPH264SimulcastEncoder::Release() {
+  layerWorkers_.reset();
+  std::vector<Layer> layers;
+  {
+    rtc::CritScope lock(&layersCrit_);
+    layers.swap(layers_);
+  }
+  // Layer encoders stop calling back once released, so their callbacks
+  // can go after this.
+  for (Layer& layer : layers) {
+    layer.encoder->Release();
+  }
+  layers.clear();
+  layerBuffers_.clear();
+  tasks_.clear();
+  return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int WinUWPH264SimulcastEncoder::Encode(
+  const VideoFrame& frame,
+  const CodecSpecificInfo* codec_specific_info,
+  const std::vector<FrameType>* frame_types) {
+  if (layers_.empty()) {
+    return WEBRTC_VIDEO_CODEC_UNINITIALIZED;
+  }
+  if (layers_.size() == 1) {
+    // The encoder follows the input size, which the quality scaler may
+    // lower, and paces and keys itself.
+    return layers_[0].encoder->Encode(frame, codec_specific_info, frame_types);
+  }
+
+  if (frame_types != nullptr) {
+    if (frame_types->size() == layers_.size()) {
+      for (size_t i = 0; i < frame_types->size(); ++i) {
+        if ((*frame_types)[i] == kVideoFrameKey)
+          scheduler_.RequestKeyFrame(i);
+      }
+    } else if (std::find(frame_types->begin(), frame_types->end(),
+                         kVideoFrameKey) != frame_types->end()) {
+      scheduler_.RequestKeyFrames();
+    }
+  }
+
+  const uint32_t layerMask =
+    scheduler_.Schedule(frame.render_time_ms(), &tasks_);
+  if (tasks_.empty()) {
+    return WEBRTC_VIDEO_CODEC_OK;
+  }
+
+  if (!pyramid_.Scale(frame.video_frame_buffer(), layerMask,
+                      &layerBuffers_)) {
+    RTC_LOG(LS_WARNING) << "Out of scaled buffers, skipping layers.";
+    for (const auto& task : tasks_) {
+      // Don't lose a key frame request with the frame.
+      if (!layerBuffers_[task.layer] && task.key_frame)
+        scheduler_.RequestKeyFrame(task.layer);
+    }
+  }
+
+  auto encodeLayer = [this, &frame, codec_specific_info](
+    const SimulcastLayerScheduler::LayerTask& task) {
+    const rtc::scoped_refptr<VideoFrameBuffer>& buffer =
+      layerBuffers_[task.layer];
+    if (!buffer) {
+      return static_cast<int>(WEBRTC_VIDEO_CODEC_OK);
+    }
+    VideoFrame layerFrame(buffer, frame.timestamp(), frame.render_time_ms(),
+      frame.rotation());
+    layerFrame.set_ntp_time_ms(frame.ntp_time_ms());
+    const std::vector<FrameType> layerTypes(
+      1, task.key_frame ? kVideoFrameKey : kVideoFrameDelta);
+    return layers_[task.layer].encoder->Encode(
+      layerFrame, codec_specific_info, &layerTypes);
+  };
+
+  // Each layer has its own sink writer and locks, so layers only share the
+  // read-only pyramid while they convert and submit their frame.
+  layerResults_.resize(tasks_.size());
+  auto runTask = [this, &encodeLayer](size_t i) {
+    layerResults_[i] = encodeLayer(tasks_[i]);
+  };
+  if (layerWorkers_) {
+    layerWorkers_->ParallelFor(tasks_.size(), runTask);
+  } else {
+    for (size_t i = 0; i < tasks_.size(); ++i)
+      runTask(i);
+  }
+
+  for (int layerResult : layerResults_) {
+    if (layerResult != WEBRTC_VIDEO_CODEC_OK)
+      return layerResult;
+  }
+  return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int WinUWPH264SimulcastEncoder::SetChannelParameters(
+  uint32_t packet_loss, int64_t rtt) {
+  for (Layer& layer : layers_) {
+    layer.encoder->SetChannelParameters(packet_loss, rtt);
+  }
+  return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int WinUWPH264SimulcastEncoder::SetRates(
+  uint32_t new_bitrate_kbit, uint32_t frame_rate) {
+  if (layers_.empty()) {
+    return WEBRTC_VIDEO_CODEC_UNINITIALIZED;
+  }
+  const std::vector<uint32_t> bitrates =
+    AllocateLayerBitrates(codec_, new_bitrate_kbit);
+  for (size_t i = 0; i < layers_.size(); ++i) {
+    SetLayerRate(i, bitrates[i], frame_rate);
+  }
+  return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int WinUWPH264SimulcastEncoder::SetRateAllocation(
+  const VideoBitrateAllocation& allocation, uint32_t frame_rate) {
+  if (layers_.empty()) {
+    return WEBRTC_VIDEO_CODEC_UNINITIALIZED;
+  }
+  for (size_t i = 0; i < layers_.size(); ++i) {
+    SetLayerRate(i, allocation.GetSpatialLayerSum(i) / 1000, frame_rate);
+  }
+  return WEBRTC_VIDEO_CODEC_OK;
+}
+
+void WinUWPH264SimulcastEncoder::SetLayerRate(
+  size_t layer, uint32_t bitrate_kbit, uint32_t frame_rate) {
+  if (layers_.size() > 1) {
+    scheduler_.SetLayerActive(layer, bitrate_kbit > 0);
+    if (bitrate_kbit == 0) {
+      return;
+    }
+    frame_rate = std::min(frame_rate, layers_[layer].codec.maxFramerate);
+  }
+  layers_[layer].encoder->SetRates(bitrate_kbit, frame_rate);
+}
+
+VideoEncoder::ScalingSettings
+WinUWPH264SimulcastEncoder::GetScalingSettings() const {
+  rtc::CritScope lock(&layersCrit_);
+  // Resolution adaptation works on a single stream only.
+  if (layers_.size() != 1) {
+    return ScalingSettings::kOff;
+  }
+  return layers_[0].encoder->GetScalingSettings();
+}
+
+const char* WinUWPH264SimulcastEncoder::ImplementationName() const {
+  rtc::CritScope lock(&layersCrit_);
+  if (layers_.size() == 1) {
+    return layers_[0].encoder->ImplementationName();
+  }
+  return "H264_MediaFoundation";
+}
+
+size_t WinUWPH264SimulcastEncoder::numberOfLayers() const {
+  rtc::CritScope lock(&layersCrit_);
+  return layers_.size();
+}
+
+PipelineStats::Snapshot WinUWPH264SimulcastEncoder::GetPipelineStats(
+  size_t layer) const {
+  rtc::CritScope lock(&layersCrit_);
+  if (layer >= layers_.size()) {
+    return PipelineStats::Snapshot();
+  }
+  return layers_[layer].encoder->GetPipelineStats();
+}
+
+EncodedBufferPool::Stats WinUWPH264SimulcastEncoder::GetOutputBufferStats(
+  size_t layer) const {
+  rtc::CritScope lock(&layersCrit_);
+  if (layer >= layers_.size()) {
+    return EncodedBufferPool::Stats();
+  }
+  return layers_[layer].encoder->GetOutputBufferStats();
+}
+
+EncodedImageCallback::Result WinUWPH264SimulcastEncoder::OnLayerEncoded(
+  size_t layer,
+  const EncodedImage& encoded_image,
+  const CodecSpecificInfo* codec_specific_info,
+  const RTPFragmentationHeader* fragmentation) {
+  // Layers complete on different Media Foundation threads.
+  rtc::CritScope lock(&callbackCrit_);
+  if (encodedCompleteCallback_ == nullptr) {
+    return EncodedImageCallback::Result(
+      EncodedImageCallback::Result::ERROR_SEND_FAILED);
+  }
+
+  CodecSpecificInfo layerInfo;
+  if (codec_specific_info != nullptr) {
+    layerInfo = *codec_specific_info;
+  } else {
+    layerInfo.codecType = kVideoCodecH264;
+  }
+  layerInfo.codecSpecific.H264.simulcast_idx = static_cast<uint8_t>(layer);
+  return encodedCompleteCallback_->OnEncodedImage(
+    encoded_image, &layerInfo, fragmentation);
+}
+
+}  // namespace webrtc
@@ -0,0 +1,114 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#ifndef THIRD_PARTY_H264_WINUWP_H264ENCODER_H264SIMULCASTENCODER_H_
+#define THIRD_PARTY_H264_WINUWP_H264ENCODER_H264SIMULCASTENCODER_H_
+
+#include <memory>
+#include <vector>
+#include "H264Encoder.h"
+#include "../Utils/ScalePyramid.h"
+#include "../Utils/SimulcastLayerScheduler.h"
+#include "../Utils/WorkerPool.h"
+#include "api/video_codecs/video_encoder.h"
+#include "rtc_base/criticalsection.h"
+
+namespace webrtc {
+
+// Encodes every simulcast stream of a VideoCodec with its own
+// WinUWPH264EncoderImpl, i.e. its own sink writer. Each captured frame is
+// scaled once into a pyramid shared by all layers and the layers due for
+// it are encoded in parallel. Rates and key frames are per layer. Without
+// simulcast streams frames and output pass straight through a single
+// encoder at the codec resolution.
+class WinUWPH264SimulcastEncoder : public VideoEncoder {
+ public:
+  WinUWPH264SimulcastEncoder();
+  // |copyOutputBuffers| is passed on to every layer encoder.
+  explicit WinUWPH264SimulcastEncoder(bool copyOutputBuffers);
+  ~WinUWPH264SimulcastEncoder() override;
+
+  int InitEncode(const VideoCodec* codec_settings,
+    int number_of_cores, size_t max_payload_size) override;
+  int RegisterEncodeCompleteCallback(EncodedImageCallback* callback) override;
+  int Release() override;
+  int Encode(const VideoFrame& input_image,
+    const CodecSpecificInfo* codec_specific_info,
+    const std::vector<FrameType>* frame_types) override;
+  int SetChannelParameters(uint32_t packet_loss, int64_t rtt) override;
+  int SetRates(uint32_t new_bitrate_kbit, uint32_t frame_rate) override;
+  int SetRateAllocation(const VideoBitrateAllocation& allocation,
+    uint32_t frame_rate) override;
+  ScalingSettings GetScalingSettings() const override;
+  const char* ImplementationName() const override;
+
+  // Number of layer encoders, one per simulcast stream, 0 before
+  // InitEncode().
+  size_t numberOfLayers() const;
+
+  // Statistics of the encoder driving simulcast stream |layer|, empty if
+  // there is no such layer. May be called from any thread.
+  PipelineStats::Snapshot GetPipelineStats(size_t layer) const;
+  EncodedBufferPool::Stats GetOutputBufferStats(size_t layer) const;
+
+ private:
+  // Tags the output of one layer with its simulcast index.
+  class LayerCallback : public EncodedImageCallback {
+   public:
+    LayerCallback(WinUWPH264SimulcastEncoder* parent, size_t layer)
+      : parent_(parent), layer_(layer) {}
+
+    Result OnEncodedImage(const EncodedImage& encoded_image,
+      const CodecSpecificInfo* codec_specific_info,
+      const RTPFragmentationHeader* fragmentation) override;
+
+   private:
+    WinUWPH264SimulcastEncoder* const parent_;
+    const size_t layer_;
+  };
+
+  struct Layer {
+    std::unique_ptr<WinUWPH264EncoderImpl> encoder;
+    std::unique_ptr<LayerCallback> callback;
+    VideoCodec codec;
+  };
+
+  EncodedImageCallback::Result OnLayerEncoded(size_t layer,
+    const EncodedImage& encoded_image,
+    const CodecSpecificInfo* codec_specific_info,
+    const RTPFragmentationHeader* fragmentation);
+
+  void SetLayerRate(size_t layer, uint32_t bitrate_kbit, uint32_t frame_rate);
+
+  // Encode() and the rate setters run on the encoder thread; only the
+  // completion callback comes from the Media Foundation threads.
+  // |layersCrit_| is taken to change |layers_| and by the getters that may
+  // run on other threads, the encoder thread reads it without.
+  rtc::CriticalSection layersCrit_;
+  std::vector<Layer> layers_;
+  ScalePyramid pyramid_;
+  SimulcastLayerScheduler scheduler_;
+  std::vector<SimulcastLayerScheduler::LayerTask> tasks_;
+  std::vector<rtc::scoped_refptr<VideoFrameBuffer>> layerBuffers_;
+  std::vector<int> layerResults_;
+  // Runs the layers of a frame in parallel. Started once per InitEncode(),
+  // null with a single layer or core.
+  std::unique_ptr<WorkerPool> layerWorkers_;
+  VideoCodec codec_;
+  int numberOfCores_ {1};
+  const bool copyOutputBuffers_;
+
+  rtc::CriticalSection callbackCrit_;
+  EncodedImageCallback* encodedCompleteCallback_ {};
+};
+
+}  // namespace webrtc
+
+#endif  // THIRD_PARTY_H264_WINUWP_H264ENCODER_H264SIMULCASTENCODER_H_
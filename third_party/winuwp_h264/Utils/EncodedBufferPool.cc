@@ -0,0 +1,150 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#include "third_party/winuwp_h264/Utils/EncodedBufferPool.h"
+
+#include <string.h>
+#include <utility>
+
+namespace webrtc {
+
+namespace {
+
+// Smallest size class; 4 KiB covers most delta frames at low bitrates.
+const int kMinSizeClassShift = 12;
+
+// Returns the size class able to hold |size| bytes, or -1 when |size| is
+// above the largest class (those buffers are never pooled).
+int SizeClassFor(size_t size, size_t num_classes) {
+  int size_class = 0;
+  size_t class_size = static_cast<size_t>(1) << kMinSizeClassShift;
+  while (class_size < size) {
+    class_size <<= 1;
+    ++size_class;
+  }
+  return static_cast<size_t>(size_class) < num_classes ? size_class : -1;
+}
+
+size_t SizeOfClass(int size_class) {
+  return static_cast<size_t>(1) << (kMinSizeClassShift + size_class);
+}
+
+}  // namespace
+
+EncodedBufferPool::Buffer::Buffer() : pool_(nullptr), capacity_(0) {}
+
+EncodedBufferPool::Buffer::Buffer(EncodedBufferPool* pool,
+                                  std::unique_ptr<uint8_t[]> data,
+                                  size_t capacity)
+    : pool_(pool), data_(std::move(data)), capacity_(capacity) {}
+
+EncodedBufferPool::Buffer::Buffer(Buffer&& other)
+    : pool_(other.pool_),
+      data_(std::move(other.data_)),
+      capacity_(other.capacity_) {
+  other.pool_ = nullptr;
+  other.capacity_ = 0;
+}
+
+EncodedBufferPool::Buffer& EncodedBufferPool::Buffer::operator=(
+    Buffer&& other) {
+  if (this != &other) {
+    Reset();
+    pool_ = other.pool_;
+    data_ = std::move(other.data_);
+    capacity_ = other.capacity_;
+    other.pool_ = nullptr;
+    other.capacity_ = 0;
+  }
+  return *this;
+}
+
+EncodedBufferPool::Buffer::~Buffer() {
+  Reset();
+}
+
+void EncodedBufferPool::Buffer::Reset() {
+  if (pool_ != nullptr && data_ != nullptr)
+    pool_->Recycle(std::move(data_), capacity_);
+  pool_ = nullptr;
+  data_.reset();
+  capacity_ = 0;
+}
+
+EncodedBufferPool::EncodedBufferPool() {
+  // Reserve up front so recycling never allocates.
+  for (auto& free_list : free_lists_)
+    free_list.reserve(kMaxFreeBuffersPerClass);
+}
+
+EncodedBufferPool::~EncodedBufferPool() {}
+
+EncodedBufferPool::Buffer EncodedBufferPool::Acquire(size_t size) {
+  int size_class = SizeClassFor(size, kNumSizeClasses);
+  size_t capacity = size_class >= 0 ? SizeOfClass(size_class) : size;
+  {
+    rtc::CritScope lock(&crit_);
+    // A buffer from a larger class beats an allocation, so frames smaller
+    // than the last keyframe reuse its buffer.
+    for (int free_class = size_class;
+         free_class >= 0 && free_class < static_cast<int>(kNumSizeClasses);
+         ++free_class) {
+      auto& free_list = free_lists_[free_class];
+      if (free_list.empty())
+        continue;
+      std::unique_ptr<uint8_t[]> data = std::move(free_list.back());
+      free_list.pop_back();
+      ++stats_.hits;
+      capacity = SizeOfClass(free_class);
+      stats_.bytes_pooled -= capacity;
+      return Buffer(this, std::move(data), capacity);
+    }
+    ++stats_.misses;
+  }
+  return Buffer(this, std::unique_ptr<uint8_t[]>(new uint8_t[capacity]),
+                capacity);
+}
+
+EncodedBufferPool::Buffer EncodedBufferPool::CopyFrom(const uint8_t* data,
+                                                      size_t size) {
+  Buffer buffer = Acquire(size);
+  memcpy(buffer.data(), data, size);
+  rtc::CritScope lock(&crit_);
+  stats_.bytes_copied += size;
+  return buffer;
+}
+
+void EncodedBufferPool::Release() {
+  rtc::CritScope lock(&crit_);
+  for (auto& free_list : free_lists_)
+    free_list.clear();
+  stats_.bytes_pooled = 0;
+}
+
+EncodedBufferPool::Stats EncodedBufferPool::GetStats() const {
+  rtc::CritScope lock(&crit_);
+  return stats_;
+}
+
+void EncodedBufferPool::Recycle(std::unique_ptr<uint8_t[]> data,
+                                size_t capacity) {
+  int size_class = SizeClassFor(capacity, kNumSizeClasses);
+  // Oversized buffers and full free lists simply drop the memory.
+  if (size_class < 0 || SizeOfClass(size_class) != capacity)
+    return;
+  rtc::CritScope lock(&crit_);
+  auto& free_list = free_lists_[size_class];
+  if (free_list.size() >= kMaxFreeBuffersPerClass)
+    return;
+  free_list.push_back(std::move(data));
+  stats_.bytes_pooled += capacity;
+}
+
+}  // namespace webrtc
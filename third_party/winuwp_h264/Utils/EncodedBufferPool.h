@@ -0,0 +1,92 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#ifndef THIRD_PARTY_H264_WINUWP_UTILS_ENCODEDBUFFERPOOL_H_
+#define THIRD_PARTY_H264_WINUWP_UTILS_ENCODEDBUFFERPOOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <vector>
+#include "rtc_base/criticalsection.h"
+
+namespace webrtc {
+
+// Recycles the byte buffers encoded frames are copied into. Buffers are
+// sorted into power-of-two size classes and Acquire() takes the smallest
+// pooled buffer that fits, so after the first keyframe the pool holds a
+// buffer large enough for every following frame and steady state encoding
+// does not touch the heap.
+class EncodedBufferPool {
+ public:
+  // Move-only handle to a pooled buffer. Goes back to the pool when
+  // destroyed, so it must not outlive the pool that handed it out.
+  class Buffer {
+   public:
+    Buffer();
+    Buffer(Buffer&& other);
+    Buffer& operator=(Buffer&& other);
+    ~Buffer();
+
+    uint8_t* data() const { return data_.get(); }
+    size_t capacity() const { return capacity_; }
+
+   private:
+    friend class EncodedBufferPool;
+    Buffer(EncodedBufferPool* pool,
+           std::unique_ptr<uint8_t[]> data,
+           size_t capacity);
+    void Reset();
+
+    EncodedBufferPool* pool_;
+    std::unique_ptr<uint8_t[]> data_;
+    size_t capacity_;
+  };
+
+  struct Stats {
+    // Buffers served from a free list.
+    uint64_t hits = 0;
+    // Buffers that had to be allocated.
+    uint64_t misses = 0;
+    // Payload bytes copied through CopyFrom().
+    uint64_t bytes_copied = 0;
+    // Bytes currently parked in the free lists.
+    uint64_t bytes_pooled = 0;
+  };
+
+  EncodedBufferPool();
+  ~EncodedBufferPool();
+
+  // Returns a buffer of at least |size| bytes, taken from the smallest
+  // non-empty size class that can hold it.
+  Buffer Acquire(size_t size);
+
+  // Acquire() plus a copy of |size| bytes from |data|.
+  Buffer CopyFrom(const uint8_t* data, size_t size);
+
+  // Frees all idle buffers. Buffers still handed out are unaffected.
+  void Release();
+
+  Stats GetStats() const;
+
+ private:
+  static const size_t kNumSizeClasses = 16;
+  static const size_t kMaxFreeBuffersPerClass = 4;
+
+  void Recycle(std::unique_ptr<uint8_t[]> data, size_t capacity);
+
+  rtc::CriticalSection crit_;
+  std::vector<std::unique_ptr<uint8_t[]>> free_lists_[kNumSizeClasses];
+  Stats stats_;
+};
+
+}  // namespace webrtc
+
+#endif  // THIRD_PARTY_H264_WINUWP_UTILS_ENCODEDBUFFERPOOL_H_
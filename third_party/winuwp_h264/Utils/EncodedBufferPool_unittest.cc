@@ -0,0 +1,150 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#include "third_party/winuwp_h264/Utils/EncodedBufferPool.h"
+
+#include <string.h>
+#include <utility>
+#include <vector>
+#include "test/gtest.h"
+
+namespace webrtc {
+
+TEST(EncodedBufferPoolTest, RoundsUpToPowerOfTwoClasses) {
+  EncodedBufferPool pool;
+  EXPECT_EQ(4096u, pool.Acquire(0).capacity());
+  EXPECT_EQ(4096u, pool.Acquire(1).capacity());
+  EXPECT_EQ(4096u, pool.Acquire(4096).capacity());
+  EXPECT_EQ(8192u, pool.Acquire(4097).capacity());
+  EXPECT_EQ(65536u, pool.Acquire(40000).capacity());
+  EXPECT_EQ(1u << 20, pool.Acquire((1 << 19) + 1).capacity());
+}
+
+TEST(EncodedBufferPoolTest, ReusesBufferOfSameClass) {
+  EncodedBufferPool pool;
+  uint8_t* first;
+  {
+    EncodedBufferPool::Buffer buffer = pool.Acquire(5000);
+    first = buffer.data();
+    EncodedBufferPool::Stats stats = pool.GetStats();
+    EXPECT_EQ(0u, stats.hits);
+    EXPECT_EQ(1u, stats.misses);
+    EXPECT_EQ(0u, stats.bytes_pooled);
+  }
+  EXPECT_EQ(8192u, pool.GetStats().bytes_pooled);
+
+  // Any size of the same class gets the recycled buffer back.
+  EncodedBufferPool::Buffer buffer = pool.Acquire(8000);
+  EXPECT_EQ(first, buffer.data());
+  EncodedBufferPool::Stats stats = pool.GetStats();
+  EXPECT_EQ(1u, stats.hits);
+  EXPECT_EQ(1u, stats.misses);
+  EXPECT_EQ(0u, stats.bytes_pooled);
+
+  // Nothing is pooled anymore, so this one is allocated.
+  EncodedBufferPool::Buffer other = pool.Acquire(100);
+  EXPECT_EQ(2u, pool.GetStats().misses);
+}
+
+TEST(EncodedBufferPoolTest, LargeBufferServesSmallAcquire) {
+  EncodedBufferPool pool;
+  uint8_t* keyframe;
+  {
+    EncodedBufferPool::Buffer buffer = pool.Acquire(200000);
+    keyframe = buffer.data();
+  }
+  EXPECT_EQ(262144u, pool.GetStats().bytes_pooled);
+
+  // A delta frame gets the keyframe's buffer instead of a new one.
+  EncodedBufferPool::Buffer buffer = pool.Acquire(3000);
+  EXPECT_EQ(keyframe, buffer.data());
+  EXPECT_EQ(262144u, buffer.capacity());
+  EncodedBufferPool::Stats stats = pool.GetStats();
+  EXPECT_EQ(1u, stats.hits);
+  EXPECT_EQ(1u, stats.misses);
+  EXPECT_EQ(0u, stats.bytes_pooled);
+
+  // It goes back to its own class.
+  buffer = EncodedBufferPool::Buffer();
+  EXPECT_EQ(262144u, pool.GetStats().bytes_pooled);
+}
+
+TEST(EncodedBufferPoolTest, PrefersSmallestFittingClass) {
+  EncodedBufferPool pool;
+  {
+    EncodedBufferPool::Buffer small = pool.Acquire(4096);
+    EncodedBufferPool::Buffer medium = pool.Acquire(16384);
+    EncodedBufferPool::Buffer large = pool.Acquire(65536);
+  }
+  EXPECT_EQ(16384u, pool.Acquire(5000).capacity());
+  EXPECT_EQ(4096u, pool.Acquire(100).capacity());
+  // Nothing pooled is large enough.
+  EXPECT_EQ(131072u, pool.Acquire(100000).capacity());
+  EncodedBufferPool::Stats stats = pool.GetStats();
+  EXPECT_EQ(2u, stats.hits);
+  EXPECT_EQ(4u, stats.misses);
+}
+
+TEST(EncodedBufferPoolTest, KeepsAtMostFourBuffersPerClass) {
+  EncodedBufferPool pool;
+  {
+    std::vector<EncodedBufferPool::Buffer> buffers;
+    for (int i = 0; i < 6; ++i)
+      buffers.push_back(pool.Acquire(4096));
+  }
+  EXPECT_EQ(4u * 4096, pool.GetStats().bytes_pooled);
+
+  std::vector<EncodedBufferPool::Buffer> buffers;
+  for (int i = 0; i < 6; ++i)
+    buffers.push_back(pool.Acquire(4096));
+  EncodedBufferPool::Stats stats = pool.GetStats();
+  EXPECT_EQ(4u, stats.hits);
+  EXPECT_EQ(8u, stats.misses);
+}
+
+TEST(EncodedBufferPoolTest, CopyFromCountsBytes) {
+  EncodedBufferPool pool;
+  const uint8_t kPayload[] = {0x00, 0x00, 0x00, 0x01, 0x65, 0x88};
+  EncodedBufferPool::Buffer buffer = pool.CopyFrom(kPayload, sizeof(kPayload));
+  EXPECT_EQ(0, memcmp(kPayload, buffer.data(), sizeof(kPayload)));
+  buffer = pool.CopyFrom(kPayload, 4);
+  EXPECT_EQ(sizeof(kPayload) + 4, pool.GetStats().bytes_copied);
+  // The second copy was made while the first buffer was still held, the
+  // assignment then returned the first one.
+  EXPECT_EQ(2u, pool.GetStats().misses);
+  EXPECT_EQ(4096u, pool.GetStats().bytes_pooled);
+}
+
+TEST(EncodedBufferPoolTest, MovedBufferReturnsOnce) {
+  EncodedBufferPool pool;
+  {
+    EncodedBufferPool::Buffer buffer = pool.Acquire(4096);
+    EncodedBufferPool::Buffer moved(std::move(buffer));
+    EXPECT_EQ(nullptr, buffer.data());
+    EXPECT_EQ(0u, buffer.capacity());
+    EXPECT_NE(nullptr, moved.data());
+  }
+  EXPECT_EQ(4096u, pool.GetStats().bytes_pooled);
+}
+
+TEST(EncodedBufferPoolTest, ReleaseFreesIdleBuffersOnly) {
+  EncodedBufferPool pool;
+  EncodedBufferPool::Buffer held = pool.Acquire(4096);
+  pool.Acquire(4096);
+  EXPECT_EQ(4096u, pool.GetStats().bytes_pooled);
+  pool.Release();
+  EXPECT_EQ(0u, pool.GetStats().bytes_pooled);
+
+  // Buffers handed out before Release() still come back.
+  held = EncodedBufferPool::Buffer();
+  EXPECT_EQ(4096u, pool.GetStats().bytes_pooled);
+}
+
+}  // namespace webrtc
@@ -0,0 +1,113 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#include "third_party/winuwp_h264/Utils/EncoderRatePolicy.h"
+
+#include <algorithm>
+
+namespace webrtc {
+
+EncoderRatePolicy::EncoderRatePolicy() : EncoderRatePolicy(Config()) {}
+
+EncoderRatePolicy::EncoderRatePolicy(const Config& config)
+    : config_(config),
+      bitrate_bps_(0),
+      target_bps_(0),
+      framerate_(0),
+      width_(0),
+      height_(0),
+      last_increase_ms_(0) {}
+
+void EncoderRatePolicy::Reset(uint32_t bitrate_bps,
+                              uint32_t framerate,
+                              int width,
+                              int height,
+                              int64_t now_ms) {
+  bitrate_bps_ = bitrate_bps;
+  target_bps_ = bitrate_bps;
+  framerate_ = framerate;
+  width_ = width;
+  height_ = height;
+  last_increase_ms_ = now_ms;
+}
+
+void EncoderRatePolicy::RestoreTarget(uint32_t target_bps) {
+  if (config_.max_bitrate_bps > 0)
+    target_bps = std::min(target_bps, config_.max_bitrate_bps);
+  if (target_bps > bitrate_bps_)
+    target_bps_ = target_bps;
+}
+
+EncoderRatePolicy::Update EncoderRatePolicy::OnRates(uint32_t bitrate_bps,
+                                                     uint32_t framerate,
+                                                     int64_t now_ms) {
+  Update update;
+
+  if (config_.max_bitrate_bps > 0)
+    bitrate_bps = std::min(bitrate_bps, config_.max_bitrate_bps);
+
+  // Any drop is taken, the encoder must not run above the estimate. A
+  // small rise also ends a pending increase: the encoder already runs at
+  // about what is asked for. 0 pauses the stream, it is not a rate.
+  if (bitrate_bps > 0) {
+    const double current = bitrate_bps_;
+    if (bitrate_bps < bitrate_bps_ ||
+        bitrate_bps > current + current * config_.bitrate_hysteresis)
+      target_bps_ = bitrate_bps;
+    else
+      target_bps_ = bitrate_bps_;
+  }
+  update.changed = StepBitrate(now_ms);
+
+  // A frame rate of 0 may happen. Ignore it.
+  if (framerate > 0) {
+    uint32_t delta = framerate > framerate_ ? framerate - framerate_
+                                            : framerate_ - framerate;
+    if (delta > config_.framerate_hysteresis) {
+      framerate_ = framerate;
+      update.changed = true;
+      update.framerate_changed = true;
+    }
+  }
+  return update;
+}
+
+EncoderRatePolicy::Update EncoderRatePolicy::Poll(int64_t now_ms) {
+  Update update;
+  update.changed = StepBitrate(now_ms);
+  return update;
+}
+
+bool EncoderRatePolicy::NeedsReinit(int width, int height) const {
+  return width != width_ || height != height_;
+}
+
+bool EncoderRatePolicy::StepBitrate(int64_t now_ms) {
+  if (target_bps_ < bitrate_bps_) {
+    bitrate_bps_ = target_bps_;
+    return true;
+  }
+  if (target_bps_ == bitrate_bps_ ||
+      now_ms - last_increase_ms_ < config_.min_increase_interval_ms) {
+    return false;
+  }
+
+  const double current = bitrate_bps_;
+  double next = current + (target_bps_ - current) * config_.increase_smoothing;
+  // Finish the ramp once the rest is within the hysteresis, instead of
+  // approaching the target forever.
+  if (target_bps_ - next <= next * config_.bitrate_hysteresis)
+    next = target_bps_;
+  bitrate_bps_ = std::min(target_bps_, static_cast<uint32_t>(next));
+  last_increase_ms_ = now_ms;
+  return true;
+}
+
+}  // namespace webrtc
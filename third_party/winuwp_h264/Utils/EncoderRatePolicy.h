@@ -0,0 +1,101 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#ifndef THIRD_PARTY_H264_WINUWP_UTILS_ENCODERRATEPOLICY_H_
+#define THIRD_PARTY_H264_WINUWP_UTILS_ENCODERRATEPOLICY_H_
+
+#include <stdint.h>
+
+namespace webrtc {
+
+// Decides when and how rate changes reach the encoder. Bitrate and frame
+// rate are applied in place where the encoder allows it; otherwise, and on
+// a change of the encoded resolution, the pipeline is rebuilt. Not thread
+// safe.
+//
+// The bitrate estimate is programmed as given, never above it. Decreases
+// apply at once. Increases become a pending target that is approached in
+// steps, at most one per |min_increase_interval_ms|, so a rising estimate
+// doesn't make the encoder burst. An estimate of 0, sent while the stream
+// is paused, keeps the last target.
+class EncoderRatePolicy {
+ public:
+  struct Config {
+    // Cap on the target bitrate, 0 for none.
+    uint32_t max_bitrate_bps = 0;
+    // Relative bitrate increase below which requests are ignored.
+    double bitrate_hysteresis = 0.1;
+    // Fraction of the gap to the requested bitrate closed per increase.
+    double increase_smoothing = 0.6;
+    // Minimum time between two bitrate increase steps.
+    int64_t min_increase_interval_ms = 500;
+    // Frame rate changes up to this many fps are ignored.
+    uint32_t framerate_hysteresis = 5;
+  };
+
+  // What the encoder has to program after OnRates() or Poll().
+  struct Update {
+    // Set when bitrate_bps() or framerate() changed.
+    bool changed = false;
+    // Set when framerate() changed.
+    bool framerate_changed = false;
+  };
+
+  EncoderRatePolicy();
+  explicit EncoderRatePolicy(const Config& config);
+
+  // Called whenever the encoder pipeline is (re)created.
+  void Reset(uint32_t bitrate_bps,
+             uint32_t framerate,
+             int width,
+             int height,
+             int64_t now_ms);
+
+  // Continues an increase that was pending before Reset(), e.g. across a
+  // resolution change. Ignored unless above the current bitrate.
+  void RestoreTarget(uint32_t target_bps);
+
+  // Takes a new estimate and applies what is due right away.
+  Update OnRates(uint32_t bitrate_bps, uint32_t framerate, int64_t now_ms);
+
+  // Takes the next step of a pending increase once the interval allows.
+  Update Poll(int64_t now_ms);
+
+  bool increase_pending() const { return target_bps_ > bitrate_bps_; }
+
+  // True when frames of this size can't be fed to the current pipeline.
+  bool NeedsReinit(int width, int height) const;
+
+  void set_max_bitrate_bps(uint32_t max_bitrate_bps) {
+    config_.max_bitrate_bps = max_bitrate_bps;
+  }
+
+  // Bitrate the encoder should currently run at.
+  uint32_t bitrate_bps() const { return bitrate_bps_; }
+  // Bitrate the steps are heading for.
+  uint32_t target_bitrate_bps() const { return target_bps_; }
+  uint32_t framerate() const { return framerate_; }
+
+ private:
+  // Moves |bitrate_bps_| towards |target_bps_|. True if it changed.
+  bool StepBitrate(int64_t now_ms);
+
+  Config config_;
+  uint32_t bitrate_bps_;
+  uint32_t target_bps_;
+  uint32_t framerate_;
+  int width_;
+  int height_;
+  int64_t last_increase_ms_;
+};
+
+}  // namespace webrtc
+
+#endif  // THIRD_PARTY_H264_WINUWP_UTILS_ENCODERRATEPOLICY_H_
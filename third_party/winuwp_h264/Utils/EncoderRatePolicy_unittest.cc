@@ -0,0 +1,237 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#include "third_party/winuwp_h264/Utils/EncoderRatePolicy.h"
+
+#include <stddef.h>
+#include "test/gtest.h"
+
+namespace webrtc {
+
+namespace {
+
+// One SetRates() call as seen from the encoder.
+struct RateSample {
+  int64_t time_ms;
+  uint32_t bitrate_kbps;
+  uint32_t framerate;
+};
+
+// Bandwidth estimates shaped like a call ramping up after start, a
+// congestion dip and the recovery, with SetRates() at about 1 Hz.
+const RateSample kRampUpAndDipTrace[] = {
+    {0, 300, 30},     {1000, 450, 30},  {2000, 700, 30},  {3000, 1000, 30},
+    {4000, 1400, 30}, {5000, 1800, 30}, {6000, 2000, 30}, {7000, 2000, 30},
+    {8000, 1200, 30}, {9000, 600, 30},  {10000, 650, 30}, {11000, 900, 30},
+    {12000, 1300, 30}, {13000, 1700, 30}, {14000, 1900, 30},
+    {15000, 1950, 30}, {16000, 1950, 30}, {17000, 1950, 30},
+};
+
+// The estimate jitters around a level while the frame rate drops and comes
+// back, as with a capturer adapting to low light.
+const RateSample kFramerateTrace[] = {
+    {0, 1000, 30},   {1000, 1020, 30}, {2000, 980, 15},  {3000, 1010, 15},
+    {4000, 990, 15}, {5000, 1000, 30}, {6000, 1030, 30}, {7000, 1000, 28},
+};
+
+const int kFrameIntervalMs = 33;
+
+// Feeds |trace| to |policy| and polls it once per frame in between, the way
+// WinUWPH264EncoderImpl does. Checks on every step that the bitrate the
+// encoder is told to use never exceeds the latest estimate.
+template <size_t N>
+void Replay(const RateSample (&trace)[N],
+            int64_t end_ms,
+            EncoderRatePolicy* policy) {
+  policy->Reset(trace[0].bitrate_kbps * 1000, trace[0].framerate, 640, 480,
+                trace[0].time_ms);
+  size_t next = 1;
+  uint32_t estimate_bps = trace[0].bitrate_kbps * 1000;
+  for (int64_t now = trace[0].time_ms; now <= end_ms;
+       now += kFrameIntervalMs) {
+    while (next < N && trace[next].time_ms <= now) {
+      estimate_bps = trace[next].bitrate_kbps * 1000;
+      policy->OnRates(estimate_bps, trace[next].framerate, now);
+      ++next;
+    }
+    if (policy->increase_pending())
+      policy->Poll(now);
+    ASSERT_LE(policy->bitrate_bps(), estimate_bps) << "at " << now << " ms";
+  }
+}
+
+}  // namespace
+
+TEST(EncoderRatePolicyTest, IncreaseConvergesToTarget) {
+  EncoderRatePolicy policy;
+  policy.Reset(1000000, 30, 640, 480, 0);
+
+  EncoderRatePolicy::Update update = policy.OnRates(2000000, 30, 1000);
+  EXPECT_TRUE(update.changed);
+  EXPECT_FALSE(update.framerate_changed);
+  EXPECT_LT(policy.bitrate_bps(), 2000000u);
+  EXPECT_GT(policy.bitrate_bps(), 1000000u);
+  EXPECT_TRUE(policy.increase_pending());
+
+  // No new estimate arrives, polling alone finishes the ramp.
+  int64_t now = 1000;
+  int steps = 0;
+  while (policy.increase_pending() && steps < 10) {
+    now += 500;
+    if (policy.Poll(now).changed)
+      ++steps;
+  }
+  EXPECT_EQ(2000000u, policy.bitrate_bps());
+  EXPECT_FALSE(policy.increase_pending());
+  EXPECT_LE(steps, 2);
+}
+
+TEST(EncoderRatePolicyTest, IncreaseWithinIntervalStaysPending) {
+  EncoderRatePolicy policy;
+  policy.Reset(1000000, 30, 640, 480, 0);
+
+  // Too soon after Reset() for a step.
+  EXPECT_FALSE(policy.OnRates(2000000, 30, 100).changed);
+  EXPECT_EQ(1000000u, policy.bitrate_bps());
+  EXPECT_EQ(2000000u, policy.target_bitrate_bps());
+  EXPECT_TRUE(policy.increase_pending());
+
+  EXPECT_FALSE(policy.Poll(499).changed);
+  EXPECT_TRUE(policy.Poll(500).changed);
+  EXPECT_GT(policy.bitrate_bps(), 1000000u);
+}
+
+TEST(EncoderRatePolicyTest, DecreaseAppliesAtOnce) {
+  EncoderRatePolicy policy;
+  policy.Reset(2000000, 30, 640, 480, 0);
+
+  // Within the increase interval, and smaller than the hysteresis.
+  EXPECT_TRUE(policy.OnRates(1950000, 30, 10).changed);
+  EXPECT_EQ(1950000u, policy.bitrate_bps());
+  EXPECT_TRUE(policy.OnRates(500000, 30, 20).changed);
+  EXPECT_EQ(500000u, policy.bitrate_bps());
+  EXPECT_FALSE(policy.increase_pending());
+}
+
+TEST(EncoderRatePolicyTest, DecreaseCancelsPendingIncrease) {
+  EncoderRatePolicy policy;
+  policy.Reset(1000000, 30, 640, 480, 0);
+  policy.OnRates(3000000, 30, 1000);
+  ASSERT_TRUE(policy.increase_pending());
+
+  policy.OnRates(800000, 30, 1100);
+  EXPECT_EQ(800000u, policy.bitrate_bps());
+  EXPECT_FALSE(policy.increase_pending());
+}
+
+TEST(EncoderRatePolicyTest, SmallIncreaseIsIgnored) {
+  EncoderRatePolicy policy;
+  policy.Reset(1000000, 30, 640, 480, 0);
+  EXPECT_FALSE(policy.OnRates(1050000, 30, 1000).changed);
+  EXPECT_EQ(1000000u, policy.bitrate_bps());
+  EXPECT_FALSE(policy.increase_pending());
+}
+
+TEST(EncoderRatePolicyTest, FramerateChangeKeepsBitrate) {
+  EncoderRatePolicy policy;
+  policy.Reset(1000000, 30, 640, 480, 0);
+
+  EncoderRatePolicy::Update update = policy.OnRates(1000000, 15, 1000);
+  EXPECT_TRUE(update.changed);
+  EXPECT_TRUE(update.framerate_changed);
+  EXPECT_EQ(15u, policy.framerate());
+  EXPECT_EQ(1000000u, policy.bitrate_bps());
+
+  // Within the frame rate hysteresis, and 0 is ignored.
+  EXPECT_FALSE(policy.OnRates(1000000, 18, 2000).changed);
+  EXPECT_FALSE(policy.OnRates(1000000, 0, 3000).changed);
+  EXPECT_EQ(15u, policy.framerate());
+}
+
+TEST(EncoderRatePolicyTest, MaxBitrateCapsTarget) {
+  EncoderRatePolicy policy;
+  policy.set_max_bitrate_bps(1500000);
+  policy.Reset(1000000, 30, 640, 480, 0);
+  policy.OnRates(4000000, 30, 1000);
+  EXPECT_EQ(1500000u, policy.target_bitrate_bps());
+  for (int64_t now = 1500; now <= 5000; now += 500)
+    policy.Poll(now);
+  EXPECT_EQ(1500000u, policy.bitrate_bps());
+}
+
+TEST(EncoderRatePolicyTest, ZeroBitrateKeepsTarget) {
+  EncoderRatePolicy policy;
+  policy.Reset(1000000, 30, 640, 480, 0);
+  EXPECT_FALSE(policy.OnRates(0, 30, 100).changed);
+  EXPECT_EQ(1000000u, policy.bitrate_bps());
+
+  // A pending increase continues, the frame rate is still taken.
+  policy.OnRates(2000000, 30, 200);
+  ASSERT_TRUE(policy.increase_pending());
+  EncoderRatePolicy::Update update = policy.OnRates(0, 15, 300);
+  EXPECT_TRUE(update.framerate_changed);
+  EXPECT_EQ(2000000u, policy.target_bitrate_bps());
+  EXPECT_TRUE(policy.Poll(500).changed);
+  EXPECT_GT(policy.bitrate_bps(), 1000000u);
+}
+
+TEST(EncoderRatePolicyTest, RestoreTargetContinuesIncrease) {
+  EncoderRatePolicy policy;
+  policy.set_max_bitrate_bps(2500000);
+  policy.Reset(1000000, 30, 640, 480, 0);
+  policy.OnRates(2000000, 30, 1000);
+  ASSERT_TRUE(policy.increase_pending());
+  const uint32_t pending_bps = policy.target_bitrate_bps();
+
+  // The pipeline is rebuilt for a new resolution at the current bitrate.
+  policy.Reset(policy.bitrate_bps(), 30, 1280, 720, 1100);
+  EXPECT_FALSE(policy.increase_pending());
+  policy.RestoreTarget(pending_bps);
+  EXPECT_TRUE(policy.increase_pending());
+  for (int64_t now = 1600; now <= 5000; now += 500)
+    policy.Poll(now);
+  EXPECT_EQ(2000000u, policy.bitrate_bps());
+
+  // Nothing to continue at or below the current bitrate, and the cap
+  // still holds.
+  policy.RestoreTarget(1000000);
+  EXPECT_FALSE(policy.increase_pending());
+  policy.RestoreTarget(4000000);
+  EXPECT_EQ(2500000u, policy.target_bitrate_bps());
+}
+
+TEST(EncoderRatePolicyTest, NeedsReinitOnlyOnResolutionChange) {
+  EncoderRatePolicy policy;
+  policy.Reset(1000000, 30, 640, 480, 0);
+  EXPECT_FALSE(policy.NeedsReinit(640, 480));
+  EXPECT_TRUE(policy.NeedsReinit(1280, 720));
+  policy.OnRates(500000, 10, 1000);
+  EXPECT_FALSE(policy.NeedsReinit(640, 480));
+}
+
+TEST(EncoderRatePolicyTest, RampUpAndDipTrace) {
+  EncoderRatePolicy policy;
+  Replay(kRampUpAndDipTrace, 20000, &policy);
+  // Settles at 1900 kbps, the last estimate is within the hysteresis.
+  EXPECT_EQ(1900000u, policy.bitrate_bps());
+  EXPECT_FALSE(policy.increase_pending());
+}
+
+TEST(EncoderRatePolicyTest, FramerateTrace) {
+  EncoderRatePolicy policy;
+  Replay(kFramerateTrace, 8000, &policy);
+  // Back at 30 fps, the final 28 is within the hysteresis.
+  EXPECT_EQ(30u, policy.framerate());
+  // The jitter stays within the hysteresis, bitrate tracks only the drops.
+  EXPECT_GE(policy.bitrate_bps(), 980000u);
+  EXPECT_LE(policy.bitrate_bps(), 1000000u);
+}
+
+}  // namespace webrtc
@@ -0,0 +1,85 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#include "third_party/winuwp_h264/Utils/H264QpParser.h"
+
+#include <string.h>
+#include <algorithm>
+
+namespace webrtc {
+
+namespace {
+
+const uint8_t kNalTypeSlice = 1;
+const uint8_t kNalTypeIdr = 5;
+const uint8_t kNalTypeSps = 7;
+const uint8_t kNalTypePps = 8;
+
+// Slice QP is in the slice header, so there is no need to unescape the
+// slice data. Headers of the single-reference streams Media Foundation
+// produces are a few dozen bytes; this leaves room for weighted
+// prediction tables.
+const size_t kMaxSliceHeaderBytes = 1024;
+
+}  // namespace
+
+H264QpParser::H264QpParser()
+    : parameter_sets_parsed_(0), parameter_sets_skipped_(0) {}
+
+H264QpParser::~H264QpParser() {}
+
+void H264QpParser::ParseFrame(const uint8_t* data,
+                              const NalUnitScanResult& units) {
+  // Don't report the QP of an earlier frame.
+  last_slice_qp_delta_.reset();
+
+  const NalUnit* last_slice = nullptr;
+  for (const NalUnit& unit : units.units) {
+    if (unit.length == 0)
+      continue;
+    switch (unit.type) {
+      case kNalTypeSps:
+      case kNalTypePps:
+        ParseParameterSet(unit.type, data + unit.offset, unit.length);
+        break;
+      case kNalTypeSlice:
+      case kNalTypeIdr:
+        last_slice = &unit;
+        break;
+      default:
+        break;
+    }
+  }
+
+  // Only the last slice's QP is reported, the others needn't be parsed.
+  if (last_slice != nullptr && sps_ && pps_) {
+    ParseSlice(data + last_slice->offset,
+               std::min(last_slice->length, kMaxSliceHeaderBytes));
+  }
+}
+
+void H264QpParser::ParseParameterSet(uint8_t type,
+                                     const uint8_t* unit,
+                                     size_t length) {
+  const bool is_sps = type == kNalTypeSps;
+  std::vector<uint8_t>* cached = is_sps ? &sps_bytes_ : &pps_bytes_;
+  if (cached->size() == length && memcmp(cached->data(), unit, length) == 0) {
+    ++parameter_sets_skipped_;
+    return;
+  }
+  cached->clear();
+  ++parameter_sets_parsed_;
+  ParseSlice(unit, length);
+  // A failed parse clears |sps_| or |pps_|.
+  if (is_sps ? sps_.has_value() : pps_.has_value())
+    cached->assign(unit, unit + length);
+}
+
+}  // namespace webrtc
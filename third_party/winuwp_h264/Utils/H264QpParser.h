@@ -0,0 +1,56 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#ifndef THIRD_PARTY_H264_WINUWP_UTILS_H264QPPARSER_H_
+#define THIRD_PARTY_H264_WINUWP_UTILS_H264QPPARSER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "common_video/h264/h264_bitstream_parser.h"
+#include "NalUnitScanner.h"
+
+namespace webrtc {
+
+// Extracts the slice QP of encoded frames for the quality scaler. Works
+// on the NAL units ScanNalUnits() already found instead of searching the
+// frame again, parses SPS and PPS only when their bytes change, and reads
+// just the slice header of the last slice rather than the whole slice.
+class H264QpParser : public H264BitstreamParser {
+ public:
+  H264QpParser();
+  ~H264QpParser() override;
+
+  // Parses one encoded frame. |units| must describe |data|.
+  void ParseFrame(const uint8_t* data, const NalUnitScanResult& units);
+
+  // QP of the last slice of the last parsed frame. False when that frame
+  // had no slice or its header could not be parsed.
+  bool GetFrameQp(int* qp) const { return GetLastSliceQp(qp); }
+
+  // Parameter sets parsed and skipped as unchanged, for diagnostics.
+  uint64_t parameter_sets_parsed() const { return parameter_sets_parsed_; }
+  uint64_t parameter_sets_skipped() const { return parameter_sets_skipped_; }
+
+ private:
+  // Parses the SPS or PPS |unit| unless it equals the last one that
+  // parsed successfully. Bytes that fail to parse are not remembered, so
+  // they are tried again when they come back.
+  void ParseParameterSet(uint8_t type, const uint8_t* unit, size_t length);
+
+  std::vector<uint8_t> sps_bytes_;
+  std::vector<uint8_t> pps_bytes_;
+  uint64_t parameter_sets_parsed_;
+  uint64_t parameter_sets_skipped_;
+};
+
+}  // namespace webrtc
+
+#endif  // THIRD_PARTY_H264_WINUWP_UTILS_H264QPPARSER_H_
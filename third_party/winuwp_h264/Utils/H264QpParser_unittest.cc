@@ -0,0 +1,309 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#include "third_party/winuwp_h264/Utils/H264QpParser.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "common_video/h264/h264_bitstream_parser.h"
+#include "rtc_base/timeutils.h"
+#include "test/gtest.h"
+
+namespace webrtc {
+
+namespace {
+
+// Writes the RBSP of a NAL unit and escapes it into Annex-B.
+class NalWriter {
+ public:
+  explicit NalWriter(uint8_t header) : header_(header) {}
+
+  void WriteBits(uint32_t value, int count) {
+    for (int i = count - 1; i >= 0; --i)
+      WriteBit((value >> i) & 1);
+  }
+  void WriteUe(uint32_t value) {
+    uint64_t coded = uint64_t{value} + 1;
+    int bits = 0;
+    while ((coded >> bits) > 1)
+      ++bits;
+    WriteBits(0, bits);
+    for (int i = bits; i >= 0; --i)
+      WriteBit(static_cast<int>((coded >> i) & 1));
+  }
+  void WriteSe(int32_t value) {
+    WriteUe(value > 0 ? 2 * value - 1 : -2 * value);
+  }
+
+  // Appends the NAL unit with a 4 byte start code to |stream|.
+  void AppendTo(std::vector<uint8_t>* stream) {
+    // rbsp_trailing_bits()
+    WriteBit(1);
+    while (bit_count_ % 8 != 0)
+      WriteBit(0);
+
+    const uint8_t kStartCode[] = {0, 0, 0, 1};
+    stream->insert(stream->end(), kStartCode, kStartCode + 4);
+    stream->push_back(header_);
+    int zeros = 0;
+    for (uint8_t byte : rbsp_) {
+      if (zeros == 2 && byte <= 3) {
+        stream->push_back(3);
+        zeros = 0;
+      }
+      stream->push_back(byte);
+      zeros = byte == 0 ? zeros + 1 : 0;
+    }
+  }
+
+ private:
+  void WriteBit(int bit) {
+    if (bit_count_ % 8 == 0)
+      rbsp_.push_back(0);
+    if (bit)
+      rbsp_.back() |= 0x80 >> (bit_count_ % 8);
+    ++bit_count_;
+  }
+
+  const uint8_t header_;
+  std::vector<uint8_t> rbsp_;
+  size_t bit_count_ = 0;
+};
+
+const int kPicInitQp = 30;
+const int kLog2MaxFrameNum = 4;
+
+// Constrained baseline, 640x480, one reference frame, like the Media
+// Foundation encoder's output.
+void AppendSps(std::vector<uint8_t>* stream) {
+  NalWriter sps(0x67);
+  sps.WriteBits(66, 8);                    // profile_idc
+  sps.WriteBits(0xc0, 8);                  // constraint_set0/1_flag
+  sps.WriteBits(31, 8);                    // level_idc
+  sps.WriteUe(0);                          // seq_parameter_set_id
+  sps.WriteUe(kLog2MaxFrameNum - 4);       // log2_max_frame_num_minus4
+  sps.WriteUe(2);                          // pic_order_cnt_type
+  sps.WriteUe(1);                          // max_num_ref_frames
+  sps.WriteBits(0, 1);                     // gaps_in_frame_num_allowed
+  sps.WriteUe(640 / 16 - 1);               // pic_width_in_mbs_minus1
+  sps.WriteUe(480 / 16 - 1);               // pic_height_in_map_units_minus1
+  sps.WriteBits(1, 1);                     // frame_mbs_only_flag
+  sps.WriteBits(1, 1);                     // direct_8x8_inference_flag
+  sps.WriteBits(0, 1);                     // frame_cropping_flag
+  sps.WriteBits(0, 1);                     // vui_parameters_present_flag
+  sps.AppendTo(stream);
+}
+
+void AppendPps(std::vector<uint8_t>* stream) {
+  NalWriter pps(0x68);
+  pps.WriteUe(0);                          // pic_parameter_set_id
+  pps.WriteUe(0);                          // seq_parameter_set_id
+  pps.WriteBits(0, 1);                     // entropy_coding_mode_flag
+  pps.WriteBits(0, 1);                     // bottom_field_pic_order...
+  pps.WriteUe(0);                          // num_slice_groups_minus1
+  pps.WriteUe(0);                          // num_ref_idx_l0_default...
+  pps.WriteUe(0);                          // num_ref_idx_l1_default...
+  pps.WriteBits(0, 1);                     // weighted_pred_flag
+  pps.WriteBits(0, 2);                     // weighted_bipred_idc
+  pps.WriteSe(kPicInitQp - 26);            // pic_init_qp_minus26
+  pps.WriteSe(0);                          // pic_init_qs_minus26
+  pps.WriteSe(0);                          // chroma_qp_index_offset
+  pps.WriteBits(1, 1);                     // deblocking_filter_control...
+  pps.WriteBits(0, 1);                     // constrained_intra_pred_flag
+  pps.WriteBits(0, 1);                     // redundant_pic_cnt_present
+  pps.AppendTo(stream);
+}
+
+// A slice with |qp| in its header followed by |data_bytes| of noise in
+// place of the macroblock layer.
+void AppendSlice(bool idr,
+                 int frame_num,
+                 int qp,
+                 size_t data_bytes,
+                 std::mt19937* rng,
+                 std::vector<uint8_t>* stream) {
+  NalWriter slice(idr ? 0x65 : 0x41);
+  slice.WriteUe(0);                        // first_mb_in_slice
+  slice.WriteUe(idr ? 7 : 5);              // slice_type, I or P
+  slice.WriteUe(0);                        // pic_parameter_set_id
+  slice.WriteBits(frame_num % (1 << kLog2MaxFrameNum), kLog2MaxFrameNum);
+  if (idr) {
+    slice.WriteUe(0);                      // idr_pic_id
+    slice.WriteBits(0, 1);                 // no_output_of_prior_pics_flag
+    slice.WriteBits(0, 1);                 // long_term_reference_flag
+  } else {
+    slice.WriteBits(0, 1);                 // num_ref_idx_active_override
+    slice.WriteBits(0, 1);                 // ref_pic_list_modification_l0
+    slice.WriteBits(0, 1);                 // adaptive_ref_pic_marking
+  }
+  slice.WriteSe(qp - kPicInitQp);          // slice_qp_delta
+  slice.WriteUe(0);                        // disable_deblocking_filter_idc
+  slice.WriteSe(0);                        // slice_alpha_c0_offset_div2
+  slice.WriteSe(0);                        // slice_beta_offset_div2
+  std::uniform_int_distribution<int> byte(0, 255);
+  for (size_t i = 0; i < data_bytes; ++i)
+    slice.WriteBits(byte(*rng), 8);
+  slice.AppendTo(stream);
+}
+
+struct EncodedFrame {
+  std::vector<uint8_t> data;
+  int qp;
+};
+
+// A stream shaped like the encoder's output: SPS and PPS repeated with
+// every key frame, one slice per frame, key frames several times the
+// size of delta frames and QP moving with the rate control.
+std::vector<EncodedFrame> MakeStream(int frames, int key_interval) {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> qp_step(-2, 2);
+  std::uniform_int_distribution<int> delta_bytes(2000, 8000);
+  std::vector<EncodedFrame> stream(frames);
+  int qp = 32;
+  for (int i = 0; i < frames; ++i) {
+    bool key = i % key_interval == 0;
+    qp = std::min(45, std::max(20, qp + qp_step(rng)));
+    EncodedFrame& frame = stream[i];
+    frame.qp = qp;
+    if (key) {
+      AppendSps(&frame.data);
+      AppendPps(&frame.data);
+    }
+    AppendSlice(key, i % key_interval, qp,
+                key ? 40000 : static_cast<size_t>(delta_bytes(rng)), &rng,
+                &frame.data);
+  }
+  return stream;
+}
+
+void ParseFrame(const EncodedFrame& frame,
+                NalUnitScanResult* units,
+                H264QpParser* parser) {
+  ScanNalUnits(frame.data.data(), frame.data.size(), units);
+  parser->ParseFrame(frame.data.data(), *units);
+}
+
+}  // namespace
+
+TEST(H264QpParserTest, ReportsSliceQp) {
+  std::vector<EncodedFrame> stream = MakeStream(30, 10);
+  H264QpParser parser;
+  NalUnitScanResult units;
+  for (const EncodedFrame& frame : stream) {
+    ParseFrame(frame, &units, &parser);
+    int qp = -1;
+    ASSERT_TRUE(parser.GetFrameQp(&qp));
+    EXPECT_EQ(frame.qp, qp);
+  }
+}
+
+TEST(H264QpParserTest, MatchesBitstreamParser) {
+  std::vector<EncodedFrame> stream = MakeStream(30, 10);
+  H264QpParser parser;
+  H264BitstreamParser reference;
+  NalUnitScanResult units;
+  for (const EncodedFrame& frame : stream) {
+    ParseFrame(frame, &units, &parser);
+    reference.ParseBitstream(frame.data.data(), frame.data.size());
+    int qp = -1;
+    int reference_qp = -1;
+    ASSERT_TRUE(parser.GetFrameQp(&qp));
+    ASSERT_TRUE(reference.GetLastSliceQp(&reference_qp));
+    EXPECT_EQ(reference_qp, qp);
+  }
+}
+
+TEST(H264QpParserTest, SkipsRepeatedParameterSets) {
+  std::vector<EncodedFrame> stream = MakeStream(30, 10);
+  H264QpParser parser;
+  NalUnitScanResult units;
+  for (const EncodedFrame& frame : stream)
+    ParseFrame(frame, &units, &parser);
+  // SPS and PPS come with each of the three key frames.
+  EXPECT_EQ(2u, parser.parameter_sets_parsed());
+  EXPECT_EQ(4u, parser.parameter_sets_skipped());
+}
+
+TEST(H264QpParserTest, NoQpWithoutSlice) {
+  H264QpParser parser;
+  NalUnitScanResult units;
+  std::vector<EncodedFrame> stream = MakeStream(1, 1);
+  ParseFrame(stream[0], &units, &parser);
+
+  EncodedFrame sei;
+  NalWriter writer(0x06);
+  writer.WriteBits(5, 8);
+  writer.WriteBits(0, 8);
+  writer.AppendTo(&sei.data);
+  ParseFrame(sei, &units, &parser);
+  int qp;
+  EXPECT_FALSE(parser.GetFrameQp(&qp));
+}
+
+// A parameter set that failed to parse must not be skipped as unchanged
+// when it shows up again, or no QP is reported for the rest of the stream.
+TEST(H264QpParserTest, RetriesParameterSetsThatFailedToParse) {
+  // Just profile_idc: too short to be an SPS.
+  EncodedFrame broken;
+  const uint8_t kTruncatedSps[] = {0, 0, 0, 1, 0x67, 66};
+  broken.data.assign(kTruncatedSps, kTruncatedSps + sizeof(kTruncatedSps));
+  AppendPps(&broken.data);
+
+  H264QpParser parser;
+  NalUnitScanResult units;
+  ParseFrame(broken, &units, &parser);
+  ParseFrame(broken, &units, &parser);
+  // The SPS both times, the PPS only once.
+  EXPECT_EQ(3u, parser.parameter_sets_parsed());
+  EXPECT_EQ(1u, parser.parameter_sets_skipped());
+
+  std::vector<EncodedFrame> stream = MakeStream(2, 10);
+  for (const EncodedFrame& frame : stream) {
+    ParseFrame(frame, &units, &parser);
+    int qp = -1;
+    ASSERT_TRUE(parser.GetFrameQp(&qp));
+    EXPECT_EQ(frame.qp, qp);
+  }
+}
+
+// Not a pass/fail test: prints the per-frame cost of getting the QP with
+// H264QpParser, given the scan the encoder does anyway, and with the
+// stock parser on the whole frame. The stream is synthetic, built above
+// with the encoder's layout and typical frame sizes.
+TEST(H264QpParserTest, Throughput) {
+  const int kRounds = 5;
+  std::vector<EncodedFrame> stream = MakeStream(300, 60);
+
+  H264QpParser parser;
+  NalUnitScanResult units;
+  int64_t start_us = rtc::TimeMicros();
+  for (int round = 0; round < kRounds; ++round) {
+    for (const EncodedFrame& frame : stream)
+      ParseFrame(frame, &units, &parser);
+  }
+  int64_t parser_us = rtc::TimeMicros() - start_us;
+
+  H264BitstreamParser reference;
+  start_us = rtc::TimeMicros();
+  for (int round = 0; round < kRounds; ++round) {
+    for (const EncodedFrame& frame : stream)
+      reference.ParseBitstream(frame.data.data(), frame.data.size());
+  }
+  int64_t reference_us = rtc::TimeMicros() - start_us;
+
+  const double frames = kRounds * stream.size();
+  printf("QP per frame: %.2f us scan + H264QpParser, "
+         "%.2f us H264BitstreamParser\n",
+         parser_us / frames, reference_us / frames);
+}
+
+}  // namespace webrtc
@@ -0,0 +1,76 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#include "third_party/winuwp_h264/Utils/MFDecoderTransformAllocator.h"
+
+#include <codecapi.h>
+#include "MFRuntimeSession.h"
+#include "Utils.h"
+#include "rtc_base/logging.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace webrtc {
+
+HRESULT CreateH264DecoderTransform(ComPtr<IMFTransform>* transform) {
+  HRESULT hr = S_OK;
+  MFRuntimeSession::EnsureComInitialized();
+
+  ComPtr<IMFTransform> decoder;
+  ON_SUCCEEDED(CoCreateInstance(CLSID_MSH264DecoderMFT, nullptr,
+                                CLSCTX_INPROC_SERVER,
+                                IID_PPV_ARGS(&decoder)));
+  if (FAILED(hr)) {
+    RTC_LOG(LS_ERROR) << "Could not create Media Foundation H264 decoder "
+                         "instance.";
+    return hr;
+  }
+
+  // Try set decoder attributes, neither is required.
+  ComPtr<IMFAttributes> decoder_attrs;
+  if (SUCCEEDED(decoder->GetAttributes(decoder_attrs.GetAddressOf()))) {
+    if (FAILED(decoder_attrs->SetUINT32(CODECAPI_AVLowLatencyMode, TRUE))) {
+      RTC_LOG(LS_WARNING)
+          << "Init warning: failed to set low latency in H264 decoder.";
+    }
+    if (FAILED(decoder_attrs->SetUINT32(CODECAPI_AVDecVideoAcceleration_H264,
+                                        TRUE))) {
+      RTC_LOG(LS_WARNING)
+          << "Init warning: failed to set HW accel in H264 decoder.";
+    }
+  }
+
+  *transform = decoder;
+  return S_OK;
+}
+
+HRESULT ResetH264DecoderTransform(const ComPtr<IMFTransform>& transform) {
+  HRESULT hr = S_OK;
+  ON_SUCCEEDED(transform->ProcessMessage(MFT_MESSAGE_COMMAND_FLUSH, 0));
+  ON_SUCCEEDED(
+      transform->ProcessMessage(MFT_MESSAGE_NOTIFY_END_STREAMING, 0));
+  // Clearing the input type also clears the output type.
+  ON_SUCCEEDED(transform->SetInputType(0, nullptr, 0));
+  return hr;
+}
+
+ComPtr<IMFTransform> MFDecoderTransformAllocator::Create() {
+  ComPtr<IMFTransform> transform;
+  if (FAILED(CreateH264DecoderTransform(&transform)))
+    return nullptr;
+  return transform;
+}
+
+bool MFDecoderTransformAllocator::Reset(
+    const ComPtr<IMFTransform>& transform) {
+  return SUCCEEDED(ResetH264DecoderTransform(transform));
+}
+
+}  // namespace webrtc
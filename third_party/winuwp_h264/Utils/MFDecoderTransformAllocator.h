@@ -0,0 +1,45 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#ifndef THIRD_PARTY_H264_WINUWP_UTILS_MFDECODERTRANSFORMALLOCATOR_H_
+#define THIRD_PARTY_H264_WINUWP_UTILS_MFDECODERTRANSFORMALLOCATOR_H_
+
+#include <mfapi.h>
+#include <mfidl.h>
+#include <mftransform.h>
+#include <wrl.h>
+#include "TransformPool.h"
+
+namespace webrtc {
+
+// Creates the Media Foundation H.264 decoder with low latency and
+// hardware acceleration requested. Expects a started MFRuntimeSession.
+HRESULT CreateH264DecoderTransform(
+    Microsoft::WRL::ComPtr<IMFTransform>* transform);
+
+// Drops anything still queued in |transform| and leaves the streaming state
+// with the media types cleared, so the next stream can set its own.
+HRESULT ResetH264DecoderTransform(
+    const Microsoft::WRL::ComPtr<IMFTransform>& transform);
+
+// Creates H.264 decoder transforms for a TransformPool and resets them to
+// an unconfigured state when a stream is done with them.
+class MFDecoderTransformAllocator
+    : public TransformAllocator<Microsoft::WRL::ComPtr<IMFTransform>> {
+ public:
+  Microsoft::WRL::ComPtr<IMFTransform> Create() override;
+  bool Reset(const Microsoft::WRL::ComPtr<IMFTransform>& transform) override;
+};
+
+typedef TransformPool<Microsoft::WRL::ComPtr<IMFTransform>> MFTransformPool;
+
+}  // namespace webrtc
+
+#endif  // THIRD_PARTY_H264_WINUWP_UTILS_MFDECODERTRANSFORMALLOCATOR_H_
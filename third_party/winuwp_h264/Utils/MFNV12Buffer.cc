@@ -0,0 +1,81 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#include "third_party/winuwp_h264/Utils/MFNV12Buffer.h"
+
+#include <algorithm>
+#include "rtc_base/logging.h"
+#include "rtc_base/refcountedobject.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace webrtc {
+
+rtc::scoped_refptr<MFNV12Buffer> MFNV12Buffer::Create(
+    ComPtr<IMFSample> sample,
+    int width, int height, int rows, int default_stride) {
+  rows = std::max(rows, height);
+
+  ComPtr<IMFMediaBuffer> buffer;
+  if (FAILED(sample->GetBufferByIndex(0, &buffer))) {
+    return nullptr;
+  }
+
+  // Prefer the 2D interface, it knows the real pitch of the surface.
+  ComPtr<IMF2DBuffer> buffer_2d;
+  BYTE* data = nullptr;
+  LONG pitch = 0;
+  if (SUCCEEDED(buffer.As(&buffer_2d)) &&
+      SUCCEEDED(buffer_2d->Lock2D(&data, &pitch))) {
+    if (pitch < width) {
+      // Bottom-up NV12 isn't something a decoder produces.
+      RTC_LOG(LS_WARNING) << "Unexpected NV12 pitch: " << pitch;
+      buffer_2d->Unlock2D();
+      return nullptr;
+    }
+  } else {
+    buffer_2d.Reset();
+    DWORD max_length, cur_length;
+    if (FAILED(buffer->Lock(&data, &max_length, &cur_length))) {
+      return nullptr;
+    }
+    pitch = default_stride >= NV12Stride(width) ? default_stride
+                                                : NV12Stride(width);
+    if (cur_length < NV12BufferSize(pitch, rows)) {
+      RTC_LOG(LS_WARNING) << "NV12 sample too small: " << cur_length;
+      buffer->Unlock();
+      return nullptr;
+    }
+  }
+
+  return new rtc::RefCountedObject<MFNV12Buffer>(
+      sample, buffer, buffer_2d, width, height, data, pitch, rows);
+}
+
+MFNV12Buffer::MFNV12Buffer(ComPtr<IMFSample> sample,
+                           ComPtr<IMFMediaBuffer> buffer,
+                           ComPtr<IMF2DBuffer> buffer_2d,
+                           int width, int height,
+                           const uint8_t* data, int stride, int rows)
+    : NV12NativeBuffer(sample.Get(), width, height,
+                       data, stride, data + stride * rows, stride),
+      sample_(sample),
+      buffer_(buffer),
+      buffer_2d_(buffer_2d) {}
+
+MFNV12Buffer::~MFNV12Buffer() {
+  if (buffer_2d_ != nullptr) {
+    buffer_2d_->Unlock2D();
+  } else {
+    buffer_->Unlock();
+  }
+}
+
+}  // namespace webrtc
@@ -0,0 +1,50 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#ifndef THIRD_PARTY_H264_WINUWP_UTILS_MFNV12BUFFER_H_
+#define THIRD_PARTY_H264_WINUWP_UTILS_MFNV12BUFFER_H_
+
+#include <mfapi.h>
+#include <mfidl.h>
+#include <wrl.h>
+#include "third_party/winuwp_h264/native_handle_buffer.h"
+#include "rtc_base/scoped_ref_ptr.h"
+
+namespace webrtc {
+
+// NV12 frame backed by a Media Foundation sample. The sample's buffer
+// stays locked, and the sample referenced, until the frame is released.
+// The native handle is the IMFSample.
+class MFNV12Buffer : public NV12NativeBuffer {
+ public:
+  // |rows| is the number of luma rows in the allocation, which can exceed
+  // |height| (e.g. 1088 for 1080p). |default_stride| is used for buffers
+  // without an IMF2DBuffer interface; 0 means the stride equals |width|.
+  static rtc::scoped_refptr<MFNV12Buffer> Create(
+      Microsoft::WRL::ComPtr<IMFSample> sample,
+      int width, int height, int rows, int default_stride);
+
+ protected:
+  MFNV12Buffer(Microsoft::WRL::ComPtr<IMFSample> sample,
+               Microsoft::WRL::ComPtr<IMFMediaBuffer> buffer,
+               Microsoft::WRL::ComPtr<IMF2DBuffer> buffer_2d,
+               int width, int height,
+               const uint8_t* data, int stride, int rows);
+  ~MFNV12Buffer() override;
+
+ private:
+  Microsoft::WRL::ComPtr<IMFSample> sample_;
+  Microsoft::WRL::ComPtr<IMFMediaBuffer> buffer_;
+  Microsoft::WRL::ComPtr<IMF2DBuffer> buffer_2d_;
+};
+
+}  // namespace webrtc
+
+#endif  // THIRD_PARTY_H264_WINUWP_UTILS_MFNV12BUFFER_H_
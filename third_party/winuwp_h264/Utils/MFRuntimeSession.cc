@@ -0,0 +1,64 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#include "third_party/winuwp_h264/Utils/MFRuntimeSession.h"
+
+#include <mfapi.h>
+#include "rtc_base/criticalsection.h"
+#include "rtc_base/logging.h"
+
+namespace webrtc {
+
+namespace {
+
+rtc::CriticalSection& RuntimeLock() {
+  // Leaked on purpose, sessions may outlive static destruction.
+  static rtc::CriticalSection* lock = new rtc::CriticalSection();
+  return *lock;
+}
+
+int runtime_refs = 0;
+
+}  // namespace
+
+MFRuntimeSession::MFRuntimeSession() {
+  rtc::CritScope lock(&RuntimeLock());
+  if (runtime_refs == 0) {
+    hr_ = MFStartup(MF_VERSION);
+    if (FAILED(hr_)) {
+      RTC_LOG(LS_ERROR) << "Failed to start Media Foundation: " << hr_;
+      return;
+    }
+  } else {
+    hr_ = S_OK;
+  }
+  ++runtime_refs;
+}
+
+MFRuntimeSession::~MFRuntimeSession() {
+  if (!started())
+    return;
+  rtc::CritScope lock(&RuntimeLock());
+  if (--runtime_refs == 0) {
+    MFShutdown();
+  }
+}
+
+void MFRuntimeSession::EnsureComInitialized() {
+  // Kept for the lifetime of the thread. Threads already in an apartment
+  // get RPC_E_CHANGED_MODE, which is fine since COM is usable there too.
+  static thread_local bool com_initialized = false;
+  if (!com_initialized) {
+    CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+    com_initialized = true;
+  }
+}
+
+}  // namespace webrtc
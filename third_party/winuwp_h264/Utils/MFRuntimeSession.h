@@ -0,0 +1,41 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#ifndef THIRD_PARTY_H264_WINUWP_UTILS_MFRUNTIMESESSION_H_
+#define THIRD_PARTY_H264_WINUWP_UTILS_MFRUNTIMESESSION_H_
+
+#include <windows.h>
+
+namespace webrtc {
+
+// One reference to the process wide Media Foundation runtime. The first
+// reference calls MFStartup() and the last one MFShutdown(), so streams
+// coming and going don't restart the runtime every time.
+class MFRuntimeSession {
+ public:
+  MFRuntimeSession();
+  ~MFRuntimeSession();
+
+  bool started() const { return SUCCEEDED(hr_); }
+
+  // Joins the calling thread to the COM multithreaded apartment once, so
+  // Media Foundation objects can be created on it.
+  static void EnsureComInitialized();
+
+ private:
+  HRESULT hr_;
+
+  MFRuntimeSession(const MFRuntimeSession&) = delete;
+  MFRuntimeSession& operator=(const MFRuntimeSession&) = delete;
+};
+
+}  // namespace webrtc
+
+#endif  // THIRD_PARTY_H264_WINUWP_UTILS_MFRUNTIMESESSION_H_
@@ -0,0 +1,119 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#include "third_party/winuwp_h264/Utils/MFSampleAllocator.h"
+
+#include <utility>
+#include "Utils.h"
+#include "rtc_base/logging.h"
+
+using Microsoft::WRL::ClassicCom;
+using Microsoft::WRL::ComPtr;
+using Microsoft::WRL::Make;
+using Microsoft::WRL::RuntimeClass;
+using Microsoft::WRL::RuntimeClassFlags;
+
+namespace webrtc {
+
+namespace {
+
+typedef MediaBufferRecycler<ComPtr<IMFSample>> MFSampleRecycler;
+
+// Invoked by a tracked sample once its last reference is released. The
+// async result holds the sample, which is alive again from here on.
+class SampleReleaseCallback
+    : public RuntimeClass<RuntimeClassFlags<ClassicCom>, IMFAsyncCallback> {
+ public:
+  explicit SampleReleaseCallback(std::shared_ptr<MFSampleRecycler> recycler)
+      : recycler_(std::move(recycler)) {}
+
+  // IMFAsyncCallback
+  IFACEMETHOD(GetParameters)(DWORD* flags, DWORD* queue) {
+    return E_NOTIMPL;
+  }
+
+  IFACEMETHOD(Invoke)(IMFAsyncResult* result) {
+    HRESULT hr = S_OK;
+    ComPtr<IUnknown> object;
+    ComPtr<IMFSample> sample;
+    ON_SUCCEEDED(result->GetObject(&object));
+    ON_SUCCEEDED(object.As(&sample));
+    if (SUCCEEDED(hr)) {
+      recycler_->Recycle(sample);
+    }
+    return hr;
+  }
+
+ private:
+  const std::shared_ptr<MFSampleRecycler> recycler_;
+};
+
+}  // namespace
+
+MFSampleAllocator::MFSampleAllocator() {}
+
+MFSampleAllocator::~MFSampleAllocator() {}
+
+ComPtr<IMFSample> MFSampleAllocator::Allocate(size_t capacity) {
+  HRESULT hr = S_OK;
+  ComPtr<IMFMediaBuffer> buffer;
+  ON_SUCCEEDED(MFCreateMemoryBuffer(static_cast<DWORD>(capacity), &buffer));
+
+  ComPtr<IMFTrackedSample> trackedSample;
+  ON_SUCCEEDED(MFCreateTrackedSample(&trackedSample));
+
+  ComPtr<IMFSample> sample;
+  ON_SUCCEEDED(trackedSample.As(&sample));
+  ON_SUCCEEDED(sample->AddBuffer(buffer.Get()));
+
+  if (FAILED(hr)) {
+    return nullptr;
+  }
+  return sample;
+}
+
+size_t MFSampleAllocator::CapacityOf(const ComPtr<IMFSample>& sample) const {
+  ComPtr<IMFMediaBuffer> buffer;
+  DWORD max_length = 0;
+  if (SUCCEEDED(sample->GetBufferByIndex(0, &buffer))) {
+    buffer->GetMaxLength(&max_length);
+  }
+  return max_length;
+}
+
+void MFSampleAllocator::SetRecycler(
+    std::shared_ptr<MFSampleRecycler> recycler) {
+  releaseCallback_ = Make<SampleReleaseCallback>(std::move(recycler));
+}
+
+bool MFSampleAllocator::Track(const ComPtr<IMFSample>& sample) {
+  // One shot: the sample forgets the callback after invoking it, so this
+  // runs each time the sample is handed out.
+  HRESULT hr = S_OK;
+  ComPtr<IMFTrackedSample> trackedSample;
+  ON_SUCCEEDED(sample.As(&trackedSample));
+  ON_SUCCEEDED(trackedSample->SetAllocator(releaseCallback_.Get(), nullptr));
+  if (FAILED(hr)) {
+    RTC_LOG(LS_WARNING) << "Failed to track sample, it won't be recycled.";
+    return false;
+  }
+  return true;
+}
+
+void MFSampleAllocator::Reset(const ComPtr<IMFSample>& sample) {
+  // Drop attributes such as CleanPoint/Discontinuity from the last use.
+  sample->DeleteAllItems();
+  ComPtr<IMFMediaBuffer> buffer;
+  if (SUCCEEDED(sample->GetBufferByIndex(0, &buffer))) {
+    buffer->SetCurrentLength(0);
+  }
+}
+
+}  // namespace webrtc
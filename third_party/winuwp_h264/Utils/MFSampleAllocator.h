@@ -0,0 +1,51 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#ifndef THIRD_PARTY_H264_WINUWP_UTILS_MFSAMPLEALLOCATOR_H_
+#define THIRD_PARTY_H264_WINUWP_UTILS_MFSAMPLEALLOCATOR_H_
+
+#include <mfapi.h>
+#include <mfidl.h>
+#include <wrl.h>
+#include <memory>
+#include "MediaBufferPool.h"
+
+namespace webrtc {
+
+// Allocates Media Foundation samples backed by a single memory buffer.
+// The samples are tracked samples (MFCreateTrackedSample): Media Foundation
+// tells the allocator through IMFTrackedSample::SetAllocator when the last
+// reference to a handed out sample is released, and the sample goes back
+// to the pool instead of being destroyed.
+class MFSampleAllocator
+    : public MediaBufferAllocator<Microsoft::WRL::ComPtr<IMFSample>> {
+ public:
+  MFSampleAllocator();
+  ~MFSampleAllocator() override;
+
+  Microsoft::WRL::ComPtr<IMFSample> Allocate(size_t capacity) override;
+  size_t CapacityOf(
+      const Microsoft::WRL::ComPtr<IMFSample>& sample) const override;
+  void SetRecycler(std::shared_ptr<MediaBufferRecycler<
+      Microsoft::WRL::ComPtr<IMFSample>>> recycler) override;
+  bool Track(const Microsoft::WRL::ComPtr<IMFSample>& sample) override;
+  void Reset(const Microsoft::WRL::ComPtr<IMFSample>& sample) override;
+
+ private:
+  // Passes released samples to the recycler. Each outstanding sample holds
+  // a reference, so it stays valid after the allocator is gone.
+  Microsoft::WRL::ComPtr<IMFAsyncCallback> releaseCallback_;
+};
+
+typedef MediaBufferPool<Microsoft::WRL::ComPtr<IMFSample>> MFSamplePool;
+
+}  // namespace webrtc
+
+#endif  // THIRD_PARTY_H264_WINUWP_UTILS_MFSAMPLEALLOCATOR_H_
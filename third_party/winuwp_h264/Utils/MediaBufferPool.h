@@ -0,0 +1,235 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#ifndef THIRD_PARTY_H264_WINUWP_UTILS_MEDIABUFFERPOOL_H_
+#define THIRD_PARTY_H264_WINUWP_UTILS_MEDIABUFFERPOOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "rtc_base/criticalsection.h"
+
+namespace webrtc {
+
+// Takes buffers back once their last user has released them. Thread safe,
+// buffers come back from whichever thread dropped the last reference.
+template <typename BufferPtr>
+class MediaBufferRecycler {
+ public:
+  virtual ~MediaBufferRecycler() {}
+
+  virtual void Recycle(BufferPtr buffer) = 0;
+};
+
+// Creates the buffers a MediaBufferPool hands out and reports when they
+// come back. |BufferPtr| is a reference counted handle (ComPtr<IMFSample>
+// on Windows). An allocator serves a single pool.
+template <typename BufferPtr>
+class MediaBufferAllocator {
+ public:
+  virtual ~MediaBufferAllocator() {}
+
+  // Returns a buffer of at least |capacity| bytes, or a null handle.
+  virtual BufferPtr Allocate(size_t capacity) = 0;
+
+  virtual size_t CapacityOf(const BufferPtr& buffer) const = 0;
+
+  // Called once by the pool. |recycler| may outlive the pool; buffers
+  // returned after that are freed.
+  virtual void SetRecycler(
+      std::shared_ptr<MediaBufferRecycler<BufferPtr>> recycler) = 0;
+
+  // Called each time |buffer| is handed out. Arranges for the buffer to be
+  // passed to the recycler, instead of being freed, once every reference
+  // to it is gone. Returns false if the buffer can't be tracked; it is
+  // then freed after use like any other.
+  virtual bool Track(const BufferPtr& buffer) = 0;
+
+  // Clears per-use state (length, attributes) before a buffer is reused.
+  virtual void Reset(const BufferPtr& buffer) = 0;
+};
+
+// Hands out buffers and gets them back through the allocator's release
+// notification, so callers never return buffers explicitly: dropping the
+// last reference is enough. Acquire() and Clear() must be called from one
+// thread at a time; buffers may come back on any thread.
+template <typename BufferPtr>
+class MediaBufferPool {
+ public:
+  struct Stats {
+    // Acquire() calls served by an idle buffer.
+    uint64_t hits = 0;
+    // Acquire() calls that allocated.
+    uint64_t misses = 0;
+    // Buffers that came back from their users.
+    uint64_t returns = 0;
+    // Returned buffers freed because the pool was full, smallest first.
+    uint64_t evictions = 0;
+  };
+
+  // |granularity| rounds allocations up so slightly bigger requests can
+  // reuse them; |max_buffers| bounds the number of idle buffers kept.
+  MediaBufferPool(MediaBufferAllocator<BufferPtr>* allocator,
+                  size_t granularity,
+                  size_t max_buffers)
+      : allocator_(allocator),
+        granularity_(granularity > 0 ? granularity : 1),
+        state_(std::make_shared<State>(allocator, max_buffers)) {
+    allocator_->SetRecycler(state_);
+  }
+
+  ~MediaBufferPool() { state_->Close(); }
+
+  // Returns the smallest idle buffer holding at least |size| bytes, or a
+  // newly allocated one. A null handle means allocation failed.
+  BufferPtr Acquire(size_t size) {
+    BufferPtr buffer = state_->TakeBestFit(size);
+    if (buffer) {
+      allocator_->Reset(buffer);
+    } else {
+      buffer = allocator_->Allocate(RoundUp(size));
+      if (!buffer)
+        return buffer;
+    }
+    if (allocator_->Track(buffer))
+      state_->OnHandedOut();
+    return buffer;
+  }
+
+  // Frees all idle buffers. Buffers still in use stay valid for their
+  // users and are pooled again when they come back.
+  void Clear() { state_->Clear(); }
+
+  // Idle buffers.
+  size_t size() const { return state_->idle(); }
+
+  // Tracked buffers handed out and not returned yet.
+  size_t outstanding() const { return state_->outstanding(); }
+
+  Stats stats() const { return state_->stats(); }
+
+ private:
+  // Shared with the allocator's release notification, which may fire after
+  // the pool is gone.
+  class State : public MediaBufferRecycler<BufferPtr> {
+   public:
+    State(MediaBufferAllocator<BufferPtr>* allocator, size_t max_buffers)
+        : allocator_(allocator), max_buffers_(max_buffers) {
+      idle_.reserve(max_buffers_);
+    }
+
+    BufferPtr TakeBestFit(size_t size) {
+      rtc::CritScope lock(&crit_);
+      size_t best = idle_.size();
+      for (size_t i = 0; i < idle_.size(); ++i) {
+        if (idle_[i].second >= size &&
+            (best == idle_.size() || idle_[i].second < idle_[best].second)) {
+          best = i;
+        }
+      }
+      if (best == idle_.size()) {
+        ++stats_.misses;
+        return BufferPtr();
+      }
+      ++stats_.hits;
+      BufferPtr buffer = std::move(idle_[best].first);
+      idle_.erase(idle_.begin() + best);
+      return buffer;
+    }
+
+    void OnHandedOut() {
+      rtc::CritScope lock(&crit_);
+      ++outstanding_;
+    }
+
+    void Recycle(BufferPtr buffer) override {
+      // Freed outside the lock.
+      BufferPtr dropped;
+      {
+        rtc::CritScope lock(&crit_);
+        if (outstanding_ > 0)
+          --outstanding_;
+        if (allocator_ == nullptr) {
+          dropped = std::move(buffer);
+        } else {
+          ++stats_.returns;
+          size_t capacity = allocator_->CapacityOf(buffer);
+          size_t smallest = 0;
+          for (size_t i = 1; i < idle_.size(); ++i) {
+            if (idle_[i].second < idle_[smallest].second)
+              smallest = i;
+          }
+          if (idle_.size() < max_buffers_) {
+            idle_.emplace_back(std::move(buffer), capacity);
+          } else if (!idle_.empty() && idle_[smallest].second < capacity) {
+            ++stats_.evictions;
+            dropped = std::move(idle_[smallest].first);
+            idle_[smallest] = std::make_pair(std::move(buffer), capacity);
+          } else {
+            ++stats_.evictions;
+            dropped = std::move(buffer);
+          }
+        }
+      }
+    }
+
+    void Clear() {
+      std::vector<std::pair<BufferPtr, size_t>> dropped;
+      rtc::CritScope lock(&crit_);
+      dropped.swap(idle_);
+      idle_.reserve(max_buffers_);
+    }
+
+    // Detaches from the allocator; the pool is going away.
+    void Close() {
+      Clear();
+      rtc::CritScope lock(&crit_);
+      allocator_ = nullptr;
+    }
+
+    size_t idle() const {
+      rtc::CritScope lock(&crit_);
+      return idle_.size();
+    }
+
+    size_t outstanding() const {
+      rtc::CritScope lock(&crit_);
+      return outstanding_;
+    }
+
+    Stats stats() const {
+      rtc::CritScope lock(&crit_);
+      return stats_;
+    }
+
+   private:
+    rtc::CriticalSection crit_;
+    MediaBufferAllocator<BufferPtr>* allocator_;
+    const size_t max_buffers_;
+    // Idle buffers with their capacity.
+    std::vector<std::pair<BufferPtr, size_t>> idle_;
+    size_t outstanding_ = 0;
+    Stats stats_;
+  };
+
+  size_t RoundUp(size_t size) const {
+    return (size + granularity_ - 1) / granularity_ * granularity_;
+  }
+
+  MediaBufferAllocator<BufferPtr>* const allocator_;
+  const size_t granularity_;
+  const std::shared_ptr<State> state_;
+};
+
+}  // namespace webrtc
+
+#endif  // THIRD_PARTY_H264_WINUWP_UTILS_MEDIABUFFERPOOL_H_
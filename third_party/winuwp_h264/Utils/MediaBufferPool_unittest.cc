@@ -0,0 +1,215 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#include "third_party/winuwp_h264/Utils/MediaBufferPool.h"
+
+#include <memory>
+#include <thread>
+#include <vector>
+#include "test/gtest.h"
+
+namespace webrtc {
+
+namespace {
+
+struct FakeBuffer {
+  explicit FakeBuffer(size_t capacity) : capacity(capacity) {}
+  size_t capacity;
+  size_t length = 0;
+  int resets = 0;
+};
+
+typedef std::shared_ptr<FakeBuffer> FakeBufferPtr;
+
+// Stands in for MFSampleAllocator. The release notification Media
+// Foundation sends when a tracked sample's last reference goes away is
+// simulated by Return().
+class FakeAllocator : public MediaBufferAllocator<FakeBufferPtr> {
+ public:
+  FakeBufferPtr Allocate(size_t capacity) override {
+    ++allocations;
+    if (fail_allocations)
+      return nullptr;
+    return std::make_shared<FakeBuffer>(capacity);
+  }
+
+  size_t CapacityOf(const FakeBufferPtr& buffer) const override {
+    return buffer->capacity;
+  }
+
+  void SetRecycler(
+      std::shared_ptr<MediaBufferRecycler<FakeBufferPtr>> recycler) override {
+    recycler_ = recycler;
+  }
+
+  bool Track(const FakeBufferPtr& buffer) override { return !fail_tracking; }
+
+  void Reset(const FakeBufferPtr& buffer) override {
+    buffer->length = 0;
+    ++buffer->resets;
+  }
+
+  void Return(FakeBufferPtr buffer) { recycler_->Recycle(std::move(buffer)); }
+
+  int allocations = 0;
+  bool fail_allocations = false;
+  bool fail_tracking = false;
+
+ private:
+  std::shared_ptr<MediaBufferRecycler<FakeBufferPtr>> recycler_;
+};
+
+typedef MediaBufferPool<FakeBufferPtr> FakePool;
+
+}  // namespace
+
+TEST(MediaBufferPoolTest, AllocatesRoundedUpBuffers) {
+  FakeAllocator allocator;
+  FakePool pool(&allocator, 1024, 4);
+  FakeBufferPtr buffer = pool.Acquire(1500);
+  ASSERT_TRUE(buffer);
+  EXPECT_EQ(2048u, buffer->capacity);
+  EXPECT_EQ(1u, pool.outstanding());
+  EXPECT_EQ(0u, pool.size());
+  EXPECT_EQ(1u, pool.stats().misses);
+  EXPECT_EQ(0u, pool.stats().hits);
+}
+
+TEST(MediaBufferPoolTest, ReusesReturnedBuffer) {
+  FakeAllocator allocator;
+  FakePool pool(&allocator, 1, 4);
+  FakeBufferPtr buffer = pool.Acquire(1000);
+  FakeBuffer* raw = buffer.get();
+  buffer->length = 1000;
+  allocator.Return(std::move(buffer));
+  EXPECT_EQ(0u, pool.outstanding());
+  EXPECT_EQ(1u, pool.size());
+
+  buffer = pool.Acquire(800);
+  EXPECT_EQ(raw, buffer.get());
+  EXPECT_EQ(0u, buffer->length);
+  EXPECT_EQ(1, buffer->resets);
+  EXPECT_EQ(1, allocator.allocations);
+  FakePool::Stats stats = pool.stats();
+  EXPECT_EQ(1u, stats.hits);
+  EXPECT_EQ(1u, stats.misses);
+  EXPECT_EQ(1u, stats.returns);
+}
+
+TEST(MediaBufferPoolTest, HandsOutSmallestBufferThatFits) {
+  FakeAllocator allocator;
+  FakePool pool(&allocator, 1, 4);
+  FakeBufferPtr small = pool.Acquire(100);
+  FakeBufferPtr medium = pool.Acquire(500);
+  FakeBufferPtr large = pool.Acquire(1000);
+  allocator.Return(large);
+  allocator.Return(small);
+  allocator.Return(medium);
+
+  EXPECT_EQ(medium, pool.Acquire(200));
+  EXPECT_EQ(small, pool.Acquire(100));
+  // Only the large one is left, too small for this request.
+  FakeBufferPtr larger = pool.Acquire(2000);
+  EXPECT_NE(large, larger);
+  EXPECT_EQ(2000u, larger->capacity);
+  EXPECT_EQ(1u, pool.size());
+}
+
+TEST(MediaBufferPoolTest, EvictsSmallestWhenFull) {
+  FakeAllocator allocator;
+  FakePool pool(&allocator, 1, 2);
+  FakeBufferPtr a = pool.Acquire(100);
+  FakeBufferPtr b = pool.Acquire(200);
+  FakeBufferPtr c = pool.Acquire(300);
+  FakeBufferPtr d = pool.Acquire(50);
+  allocator.Return(a);
+  allocator.Return(b);
+  // Replaces |a|.
+  allocator.Return(c);
+  // Smaller than everything pooled, dropped itself.
+  allocator.Return(d);
+  EXPECT_EQ(2u, pool.size());
+  EXPECT_EQ(2u, pool.stats().evictions);
+  EXPECT_EQ(0u, pool.outstanding());
+
+  EXPECT_EQ(b, pool.Acquire(1));
+  EXPECT_EQ(c, pool.Acquire(1));
+}
+
+TEST(MediaBufferPoolTest, UntrackedBuffersAreNotCounted) {
+  FakeAllocator allocator;
+  allocator.fail_tracking = true;
+  FakePool pool(&allocator, 1, 4);
+  FakeBufferPtr buffer = pool.Acquire(100);
+  ASSERT_TRUE(buffer);
+  EXPECT_EQ(0u, pool.outstanding());
+}
+
+TEST(MediaBufferPoolTest, FailedAllocationReturnsNull) {
+  FakeAllocator allocator;
+  allocator.fail_allocations = true;
+  FakePool pool(&allocator, 1, 4);
+  EXPECT_FALSE(pool.Acquire(100));
+  EXPECT_EQ(0u, pool.outstanding());
+}
+
+TEST(MediaBufferPoolTest, ClearKeepsOutstandingBuffers) {
+  FakeAllocator allocator;
+  FakePool pool(&allocator, 1, 4);
+  FakeBufferPtr idle = pool.Acquire(100);
+  FakeBufferPtr busy = pool.Acquire(100);
+  std::weak_ptr<FakeBuffer> idle_ref = idle;
+  allocator.Return(std::move(idle));
+  pool.Clear();
+  EXPECT_TRUE(idle_ref.expired());
+  EXPECT_EQ(0u, pool.size());
+
+  allocator.Return(busy);
+  EXPECT_EQ(1u, pool.size());
+  EXPECT_EQ(busy, pool.Acquire(100));
+}
+
+TEST(MediaBufferPoolTest, BufferReturnedAfterPoolIsGoneIsFreed) {
+  FakeAllocator allocator;
+  FakeBufferPtr buffer;
+  {
+    FakePool pool(&allocator, 1, 4);
+    buffer = pool.Acquire(100);
+  }
+  std::weak_ptr<FakeBuffer> ref = buffer;
+  allocator.Return(std::move(buffer));
+  EXPECT_TRUE(ref.expired());
+}
+
+TEST(MediaBufferPoolTest, BuffersComeBackFromOtherThreads) {
+  const int kRounds = 10000;
+  FakeAllocator allocator;
+  FakePool pool(&allocator, 1, 4);
+  std::vector<FakeBufferPtr> batch;
+  for (int round = 0; round < kRounds; ++round) {
+    batch.clear();
+    for (int i = 0; i < 3; ++i)
+      batch.push_back(pool.Acquire(100));
+    std::thread releaser([&allocator, &batch] {
+      for (FakeBufferPtr& buffer : batch)
+        allocator.Return(std::move(buffer));
+    });
+    // Acquire() races with the returns.
+    FakeBufferPtr extra = pool.Acquire(100);
+    releaser.join();
+    allocator.Return(std::move(extra));
+  }
+  EXPECT_EQ(0u, pool.outstanding());
+  EXPECT_LE(pool.size(), 4u);
+  // Four buffers cover every round once the pool is warm.
+  EXPECT_LE(allocator.allocations, 4);
+}
+
+}  // namespace webrtc
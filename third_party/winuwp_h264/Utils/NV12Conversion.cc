@@ -0,0 +1,125 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#include "third_party/winuwp_h264/Utils/NV12Conversion.h"
+
+#include <algorithm>
+#include <thread>
+
+#include "libyuv/convert.h"
+#include "libyuv/convert_from.h"
+#include "libyuv/planar_functions.h"
+#include "third_party/winuwp_h264/Utils/WorkerPool.h"
+
+namespace webrtc {
+
+namespace {
+
+// Frames of at least this many pixels are converted in slices.
+const int kMinSlicedPixels = 1920 * 1080;
+const int kMaxSlices = 4;
+
+int NumberOfCores() {
+  static const int cores =
+      static_cast<int>(std::thread::hardware_concurrency());
+  return std::max(1, cores);
+}
+
+// Calls |convert(first_row, rows)| for |slices| horizontal bands of even
+// height; the caller converts one band, |workers| the others.
+template <typename Convert>
+void RunSliced(int height, int slices, WorkerPool* workers,
+               const Convert& convert) {
+  if (workers != nullptr)
+    slices = std::min(slices, static_cast<int>(workers->num_threads()) + 1);
+  if (workers == nullptr || slices <= 1) {
+    convert(0, height);
+    return;
+  }
+  const int slice_rows = ((height + slices - 1) / slices + 1) & ~1;
+  const int count = (height + slice_rows - 1) / slice_rows;
+  workers->ParallelFor(count, [&](size_t slice) {
+    int row = static_cast<int>(slice) * slice_rows;
+    convert(row, std::min(slice_rows, height - row));
+  });
+}
+
+}  // namespace
+
+int NV12Stride(int width) {
+  return (width + 1) & ~1;
+}
+
+size_t NV12BufferSize(int stride, int rows) {
+  return static_cast<size_t>(stride) * rows +
+         static_cast<size_t>(stride) * ((rows + 1) / 2);
+}
+
+int NV12ConversionSlices(int width, int height) {
+  if (width * height < kMinSlicedPixels)
+    return 1;
+  return std::min(NumberOfCores(), kMaxSlices);
+}
+
+std::unique_ptr<WorkerPool> CreateNV12ConversionWorkers(int width,
+                                                        int height) {
+  int slices = NV12ConversionSlices(width, height);
+  if (slices <= 1)
+    return nullptr;
+  return std::unique_ptr<WorkerPool>(new WorkerPool(slices - 1));
+}
+
+void ConvertI420ToNV12(const uint8_t* src_y, int src_stride_y,
+                       const uint8_t* src_u, int src_stride_u,
+                       const uint8_t* src_v, int src_stride_v,
+                       const NV12Planes& dst,
+                       int width, int height,
+                       WorkerPool* workers) {
+  RunSliced(height, NV12ConversionSlices(width, height), workers,
+            [&](int row, int rows) {
+              int chroma_row = row / 2;
+              libyuv::I420ToNV12(
+                  src_y + row * src_stride_y, src_stride_y,
+                  src_u + chroma_row * src_stride_u, src_stride_u,
+                  src_v + chroma_row * src_stride_v, src_stride_v,
+                  dst.y + row * dst.stride_y, dst.stride_y,
+                  dst.uv + chroma_row * dst.stride_uv, dst.stride_uv,
+                  width, rows);
+            });
+}
+
+void ConvertNV12ToI420(const ConstNV12Planes& src,
+                       uint8_t* dst_y, int dst_stride_y,
+                       uint8_t* dst_u, int dst_stride_u,
+                       uint8_t* dst_v, int dst_stride_v,
+                       int width, int height,
+                       WorkerPool* workers) {
+  RunSliced(height, NV12ConversionSlices(width, height), workers,
+            [&](int row, int rows) {
+              int chroma_row = row / 2;
+              libyuv::NV12ToI420(
+                  src.y + row * src.stride_y, src.stride_y,
+                  src.uv + chroma_row * src.stride_uv, src.stride_uv,
+                  dst_y + row * dst_stride_y, dst_stride_y,
+                  dst_u + chroma_row * dst_stride_u, dst_stride_u,
+                  dst_v + chroma_row * dst_stride_v, dst_stride_v,
+                  width, rows);
+            });
+}
+
+void CopyNV12(const ConstNV12Planes& src,
+              const NV12Planes& dst,
+              int width, int height) {
+  libyuv::CopyPlane(src.y, src.stride_y, dst.y, dst.stride_y, width, height);
+  libyuv::CopyPlane(src.uv, src.stride_uv, dst.uv, dst.stride_uv,
+                    (width + 1) / 2 * 2, (height + 1) / 2);
+}
+
+}  // namespace webrtc
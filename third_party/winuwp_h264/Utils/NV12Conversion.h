@@ -0,0 +1,83 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#ifndef THIRD_PARTY_H264_WINUWP_UTILS_NV12CONVERSION_H_
+#define THIRD_PARTY_H264_WINUWP_UTILS_NV12CONVERSION_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+
+namespace webrtc {
+
+class WorkerPool;
+
+// Plane pointers and strides (in bytes) of an NV12 image. Strides may be
+// larger than the width for padded surfaces.
+struct NV12Planes {
+  uint8_t* y;
+  int stride_y;
+  uint8_t* uv;
+  int stride_uv;
+};
+
+struct ConstNV12Planes {
+  const uint8_t* y;
+  int stride_y;
+  const uint8_t* uv;
+  int stride_uv;
+};
+
+// Smallest stride of a contiguous NV12 image |width| pixels wide. A chroma
+// row holds (width + 1) / 2 interleaved U/V pairs, one byte more than the
+// width for odd widths, and both planes share the stride.
+int NV12Stride(int width);
+
+// Bytes needed by a contiguous NV12 image with |stride| and |rows| luma
+// rows, i.e. the luma plane followed by the interleaved chroma plane.
+// |stride| must be even so it also holds a chroma row, see NV12Stride().
+size_t NV12BufferSize(int stride, int rows);
+
+// Number of row slices a |width|x|height| conversion is split into. Frames
+// below 1080p are converted on the calling thread (1 slice).
+int NV12ConversionSlices(int width, int height);
+
+// Worker threads for converting |width|x|height| frames in slices, or null
+// when such frames are converted on the calling thread. Each encoder and
+// decoder owns its workers, so their conversions don't wait on each other.
+std::unique_ptr<WorkerPool> CreateNV12ConversionWorkers(int width,
+                                                        int height);
+
+// The conversions below split the frame into horizontal slices of even
+// height and convert them in parallel on |workers| when
+// NV12ConversionSlices() > 1. A null |workers| converts on the caller.
+void ConvertI420ToNV12(const uint8_t* src_y, int src_stride_y,
+                       const uint8_t* src_u, int src_stride_u,
+                       const uint8_t* src_v, int src_stride_v,
+                       const NV12Planes& dst,
+                       int width, int height,
+                       WorkerPool* workers);
+
+void ConvertNV12ToI420(const ConstNV12Planes& src,
+                       uint8_t* dst_y, int dst_stride_y,
+                       uint8_t* dst_u, int dst_stride_u,
+                       uint8_t* dst_v, int dst_stride_v,
+                       int width, int height,
+                       WorkerPool* workers);
+
+// Plain row copy between NV12 images of different strides. Chroma rows are
+// (width + 1) & ~1 bytes, so both chroma strides must hold that many.
+void CopyNV12(const ConstNV12Planes& src,
+              const NV12Planes& dst,
+              int width, int height);
+
+}  // namespace webrtc
+
+#endif  // THIRD_PARTY_H264_WINUWP_UTILS_NV12CONVERSION_H_
@@ -0,0 +1,245 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#include "third_party/winuwp_h264/Utils/NV12Conversion.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+#include "rtc_base/timeutils.h"
+#include "test/gtest.h"
+#include "third_party/winuwp_h264/Utils/WorkerPool.h"
+
+namespace webrtc {
+
+namespace {
+
+// An I420 image with padded strides, filled with noise.
+struct I420Image {
+  I420Image(int width, int height, std::mt19937* rng)
+      : width(width),
+        height(height),
+        stride_y(width + 7),
+        stride_uv((width + 1) / 2 + 5),
+        y(static_cast<size_t>(stride_y) * height),
+        u(static_cast<size_t>(stride_uv) * ((height + 1) / 2)),
+        v(u.size()) {
+    std::uniform_int_distribution<int> byte(0, 255);
+    for (uint8_t& p : y)
+      p = static_cast<uint8_t>(byte(*rng));
+    for (uint8_t& p : u)
+      p = static_cast<uint8_t>(byte(*rng));
+    for (uint8_t& p : v)
+      p = static_cast<uint8_t>(byte(*rng));
+  }
+
+  int width;
+  int height;
+  int stride_y;
+  int stride_uv;
+  std::vector<uint8_t> y;
+  std::vector<uint8_t> u;
+  std::vector<uint8_t> v;
+};
+
+// Contiguous NV12 image laid out the way the encoder fills its samples.
+// The guard byte after the image catches writes past NV12BufferSize().
+struct NV12Image {
+  NV12Image(int width, int height)
+      : stride(NV12Stride(width)),
+        height(height),
+        data(NV12BufferSize(stride, height) + 1, 0xcd) {}
+
+  NV12Planes planes() {
+    NV12Planes planes = {data.data(), stride,
+                         data.data() + stride * height, stride};
+    return planes;
+  }
+  ConstNV12Planes const_planes() {
+    ConstNV12Planes planes = {data.data(), stride,
+                              data.data() + stride * height, stride};
+    return planes;
+  }
+  uint8_t guard() const { return data.back(); }
+
+  int stride;
+  int height;
+  std::vector<uint8_t> data;
+};
+
+void ExpectMatchesSource(const I420Image& src, NV12Image* nv12) {
+  NV12Planes planes = nv12->planes();
+  for (int row = 0; row < src.height; ++row) {
+    for (int col = 0; col < src.width; ++col) {
+      ASSERT_EQ(src.y[row * src.stride_y + col],
+                planes.y[row * planes.stride_y + col]);
+    }
+  }
+  for (int row = 0; row < (src.height + 1) / 2; ++row) {
+    for (int col = 0; col < (src.width + 1) / 2; ++col) {
+      const uint8_t* uv = planes.uv + row * planes.stride_uv + col * 2;
+      ASSERT_EQ(src.u[row * src.stride_uv + col], uv[0]);
+      ASSERT_EQ(src.v[row * src.stride_uv + col], uv[1]);
+    }
+  }
+  EXPECT_EQ(0xcd, nv12->guard());
+}
+
+void ConvertToNV12(const I420Image& src,
+                   NV12Image* dst,
+                   WorkerPool* workers) {
+  ConvertI420ToNV12(src.y.data(), src.stride_y, src.u.data(), src.stride_uv,
+                    src.v.data(), src.stride_uv, dst->planes(), src.width,
+                    src.height, workers);
+}
+
+// Converts |src| to NV12 and back, checking both results.
+void ExpectRoundTrip(const I420Image& src, WorkerPool* workers) {
+  NV12Image nv12(src.width, src.height);
+  ConvertToNV12(src, &nv12, workers);
+  ExpectMatchesSource(src, &nv12);
+
+  std::vector<uint8_t> y(src.y.size());
+  std::vector<uint8_t> u(src.u.size());
+  std::vector<uint8_t> v(src.v.size());
+  ConvertNV12ToI420(nv12.const_planes(), y.data(), src.stride_y, u.data(),
+                    src.stride_uv, v.data(), src.stride_uv, src.width,
+                    src.height, workers);
+  for (int row = 0; row < src.height; ++row) {
+    ASSERT_EQ(0, memcmp(&src.y[row * src.stride_y], &y[row * src.stride_y],
+                        src.width));
+  }
+  for (int row = 0; row < (src.height + 1) / 2; ++row) {
+    size_t offset = row * src.stride_uv;
+    ASSERT_EQ(0, memcmp(&src.u[offset], &u[offset], (src.width + 1) / 2));
+    ASSERT_EQ(0, memcmp(&src.v[offset], &v[offset], (src.width + 1) / 2));
+  }
+}
+
+}  // namespace
+
+TEST(NV12ConversionTest, StrideHoldsChromaRow) {
+  EXPECT_EQ(640, NV12Stride(640));
+  EXPECT_EQ(642, NV12Stride(641));
+  EXPECT_EQ(2, NV12Stride(1));
+  EXPECT_EQ(640u * 480 + 640 * 240, NV12BufferSize(640, 480));
+  EXPECT_EQ(642u * 481 + 642 * 241, NV12BufferSize(642, 481));
+}
+
+TEST(NV12ConversionTest, SlicesOnlyLargeFrames) {
+  EXPECT_EQ(1, NV12ConversionSlices(1280, 720));
+  EXPECT_GE(NV12ConversionSlices(1920, 1080), 1);
+  EXPECT_LE(NV12ConversionSlices(3840, 2160), 4);
+  EXPECT_FALSE(CreateNV12ConversionWorkers(1280, 720));
+  std::unique_ptr<WorkerPool> workers = CreateNV12ConversionWorkers(1920, 1080);
+  if (workers) {
+    EXPECT_EQ(static_cast<size_t>(NV12ConversionSlices(1920, 1080) - 1),
+              workers->num_threads());
+  }
+}
+
+TEST(NV12ConversionTest, I420ToNV12OddSizes) {
+  std::mt19937 rng(7);
+  const int kSizes[][2] = {{1, 1}, {2, 2}, {3, 5}, {17, 9}, {641, 361}};
+  for (const auto& size : kSizes) {
+    SCOPED_TRACE(size[0]);
+    SCOPED_TRACE(size[1]);
+    I420Image src(size[0], size[1], &rng);
+    NV12Image nv12(size[0], size[1]);
+    ConvertToNV12(src, &nv12, nullptr);
+    ExpectMatchesSource(src, &nv12);
+  }
+}
+
+// 1080p and up take the sliced path; odd heights check the last slice.
+TEST(NV12ConversionTest, SlicedConversionsMatchSource) {
+  std::mt19937 rng(11);
+  WorkerPool workers(3);
+  const int kSizes[][2] = {{1920, 1080}, {1921, 1081}, {2560, 1441}};
+  for (const auto& size : kSizes) {
+    SCOPED_TRACE(size[0]);
+    I420Image src(size[0], size[1], &rng);
+    ExpectRoundTrip(src, &workers);
+    // Without workers the same frame is converted on the caller.
+    ExpectRoundTrip(src, nullptr);
+  }
+}
+
+// Converters with their own workers run side by side instead of queueing
+// behind one another.
+TEST(NV12ConversionTest, ConvertersUseTheirOwnWorkers) {
+  std::mt19937 rng(13);
+  I420Image src(1920, 1080, &rng);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 3; ++t) {
+    threads.emplace_back([&src] {
+      WorkerPool workers(2);
+      for (int i = 0; i < 5; ++i)
+        ExpectRoundTrip(src, &workers);
+    });
+  }
+  for (std::thread& thread : threads)
+    thread.join();
+}
+
+TEST(NV12ConversionTest, CopyNV12OddWidth) {
+  std::mt19937 rng(3);
+  I420Image src(33, 17, &rng);
+  NV12Image nv12(33, 17);
+  ConvertToNV12(src, &nv12, nullptr);
+
+  // Copy into a padded image and back into a packed one.
+  const int kPaddedStride = 64;
+  std::vector<uint8_t> padded(NV12BufferSize(kPaddedStride, 17));
+  NV12Planes padded_planes = {padded.data(), kPaddedStride,
+                              padded.data() + kPaddedStride * 17,
+                              kPaddedStride};
+  CopyNV12(nv12.const_planes(), padded_planes, 33, 17);
+  NV12Image copy(33, 17);
+  ConstNV12Planes padded_src = {padded_planes.y, kPaddedStride,
+                                padded_planes.uv, kPaddedStride};
+  CopyNV12(padded_src, copy.planes(), 33, 17);
+  ExpectMatchesSource(src, &copy);
+}
+
+// Not a pass/fail test: prints the conversion time per 1080p frame.
+TEST(NV12ConversionTest, Throughput) {
+  const int kIterations = 100;
+  std::mt19937 rng(5);
+  I420Image src(1920, 1080, &rng);
+  NV12Image nv12(1920, 1080);
+  std::vector<uint8_t> y(src.y.size());
+  std::vector<uint8_t> u(src.u.size());
+  std::vector<uint8_t> v(src.v.size());
+  std::unique_ptr<WorkerPool> workers = CreateNV12ConversionWorkers(1920, 1080);
+
+  int64_t start_us = rtc::TimeMicros();
+  for (int i = 0; i < kIterations; ++i)
+    ConvertToNV12(src, &nv12, workers.get());
+  int64_t to_nv12_us = rtc::TimeMicros() - start_us;
+
+  start_us = rtc::TimeMicros();
+  for (int i = 0; i < kIterations; ++i) {
+    ConvertNV12ToI420(nv12.const_planes(), y.data(), src.stride_y, u.data(),
+                      src.stride_uv, v.data(), src.stride_uv, src.width,
+                      src.height, workers.get());
+  }
+  int64_t to_i420_us = rtc::TimeMicros() - start_us;
+
+  printf("1080p in %d slices: I420->NV12 %.0f us, NV12->I420 %.0f us\n",
+         NV12ConversionSlices(1920, 1080),
+         static_cast<double>(to_nv12_us) / kIterations,
+         static_cast<double>(to_i420_us) / kIterations);
+}
+
+}  // namespace webrtc
@@ -0,0 +1,291 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#include "third_party/winuwp_h264/Utils/NalUnitScanner.h"
+
+#include "rtc_base/system/arch.h"
+
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+#include <emmintrin.h>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif defined(WEBRTC_HAS_NEON)
+#include <arm_neon.h>
+#endif
+
+#if defined(WEBRTC_ARCH_X86_FAMILY) && (defined(__GNUC__) || defined(__clang__))
+#define NAL_SCANNER_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define NAL_SCANNER_TARGET_AVX2
+#endif
+
+namespace webrtc {
+
+namespace {
+
+// Enough for SPS + PPS + a sliced IDR frame without growing.
+const size_t kInitialNalUnitCapacity = 16;
+
+const uint8_t kNalTypeMask = 0x1f;
+const uint8_t kNalTypeIdr = 0x05;
+const uint8_t kNalTypeSps = 0x07;
+const uint8_t kNalTypePps = 0x08;
+const uint8_t kNalTypeAud = 0x09;
+
+// Turns "00 00 01" candidates into NAL units. The kernels only have to
+// report every position of the 3-byte pattern in increasing order; all
+// decisions (4-byte prefix, AUD skipping, the 6 byte step after a hit)
+// live here so every kernel produces exactly the same fragment table.
+class NalUnitCollector {
+ public:
+  NalUnitCollector(const uint8_t* data, size_t size, NalUnitScanResult* result)
+      : data_(data),
+        size_(size),
+        limit_(size > 5 ? size - 5 : 0),
+        resume_(0),
+        result_(result) {
+    result_->Clear();
+  }
+
+  // End (exclusive) of the range in which "00 00 01" has to be reported.
+  // One past |limit_| so a 4-byte start code right at the limit is seen.
+  size_t search_end() const { return size_ > 5 ? limit_ + 1 : 0; }
+
+  void OnStartCode(size_t pos) {
+    size_t start;
+    size_t prefix;
+    if (pos >= 1 && pos - 1 >= resume_ && data_[pos - 1] == 0x00) {
+      start = pos - 1;
+      prefix = 4;
+    } else if (pos >= resume_ && pos < limit_) {
+      start = pos;
+      prefix = 3;
+    } else {
+      return;
+    }
+
+    uint8_t type = data_[start + prefix] & kNalTypeMask;
+    if (type == kNalTypeAud)
+      return;
+
+    std::vector<NalUnit>& units = result_->units;
+    if (!units.empty()) {
+      NalUnit& previous = units.back();
+      previous.length = start - previous.offset;
+    }
+    NalUnit unit;
+    unit.offset = start + prefix;
+    unit.length = 0;
+    unit.type = type;
+    units.push_back(unit);
+
+    if (type == kNalTypeIdr)
+      result_->has_idr = true;
+    else if (type == kNalTypeSps)
+      result_->has_sps = true;
+    else if (type == kNalTypePps)
+      result_->has_pps = true;
+
+    resume_ = start + 6;
+  }
+
+  void Finish() {
+    std::vector<NalUnit>& units = result_->units;
+    if (!units.empty()) {
+      NalUnit& last = units.back();
+      last.length = size_ - last.offset;
+    }
+  }
+
+ private:
+  const uint8_t* data_;
+  const size_t size_;
+  const size_t limit_;
+  size_t resume_;
+  NalUnitScanResult* result_;
+};
+
+inline int CountTrailingZeros(uint32_t mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+inline void EmitMask(uint32_t mask, size_t base, NalUnitCollector* collector) {
+  while (mask != 0) {
+    collector->OnStartCode(base + CountTrailingZeros(mask));
+    mask &= mask - 1;
+  }
+}
+
+void FindStartCodesScalar(const uint8_t* data,
+                          size_t begin,
+                          size_t end,
+                          NalUnitCollector* collector) {
+  for (size_t i = begin; i < end; ++i) {
+    if (data[i + 2] == 0x01 && data[i + 1] == 0x00 && data[i] == 0x00)
+      collector->OnStartCode(i);
+  }
+}
+
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+
+void FindStartCodesSse2(const uint8_t* data,
+                        size_t end,
+                        NalUnitCollector* collector) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i one = _mm_set1_epi8(1);
+  size_t i = 0;
+  for (; i + 16 <= end; i += 16) {
+    __m128i b2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 2));
+    __m128i ones = _mm_cmpeq_epi8(b2, one);
+    if (_mm_movemask_epi8(ones) == 0)
+      continue;
+    __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 1));
+    __m128i hits = _mm_and_si128(
+        ones, _mm_and_si128(_mm_cmpeq_epi8(b0, zero), _mm_cmpeq_epi8(b1, zero)));
+    EmitMask(static_cast<uint32_t>(_mm_movemask_epi8(hits)), i, collector);
+  }
+  FindStartCodesScalar(data, i, end, collector);
+}
+
+NAL_SCANNER_TARGET_AVX2
+void FindStartCodesAvx2(const uint8_t* data,
+                        size_t end,
+                        NalUnitCollector* collector) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i one = _mm256_set1_epi8(1);
+  size_t i = 0;
+  for (; i + 32 <= end; i += 32) {
+    __m256i b2 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 2));
+    __m256i ones = _mm256_cmpeq_epi8(b2, one);
+    if (_mm256_movemask_epi8(ones) == 0)
+      continue;
+    __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+    __m256i b1 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 1));
+    __m256i hits = _mm256_and_si256(
+        ones, _mm256_and_si256(_mm256_cmpeq_epi8(b0, zero),
+                               _mm256_cmpeq_epi8(b1, zero)));
+    EmitMask(static_cast<uint32_t>(_mm256_movemask_epi8(hits)), i, collector);
+  }
+  FindStartCodesScalar(data, i, end, collector);
+}
+
+bool CpuSupportsAvx2() {
+  int regs[4] = {0, 0, 0, 0};
+#if defined(_MSC_VER)
+  __cpuid(regs, 0);
+  if (regs[0] < 7)
+    return false;
+  __cpuid(regs, 1);
+#else
+  unsigned int a, b, c, d;
+  if (__get_cpuid_max(0, nullptr) < 7)
+    return false;
+  __cpuid(1, a, b, c, d);
+  regs[2] = static_cast<int>(c);
+#endif
+  // The OS has to save the YMM state (OSXSAVE + XCR0 bits 1 and 2).
+  const int kOsxsave = 1 << 27;
+  const int kAvx = 1 << 28;
+  if ((regs[2] & (kOsxsave | kAvx)) != (kOsxsave | kAvx))
+    return false;
+#if defined(_MSC_VER)
+  unsigned long long xcr0 = _xgetbv(0);
+#else
+  unsigned int xcr0_lo, xcr0_hi;
+  __asm__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+  unsigned long long xcr0 = xcr0_lo;
+#endif
+  if ((xcr0 & 0x6) != 0x6)
+    return false;
+#if defined(_MSC_VER)
+  __cpuidex(regs, 7, 0);
+#else
+  __cpuid_count(7, 0, a, b, c, d);
+  regs[1] = static_cast<int>(b);
+#endif
+  return (regs[1] & (1 << 5)) != 0;
+}
+
+#elif defined(WEBRTC_HAS_NEON)
+
+void FindStartCodesNeon(const uint8_t* data,
+                        size_t end,
+                        NalUnitCollector* collector) {
+  const uint8x16_t zero = vdupq_n_u8(0);
+  const uint8x16_t one = vdupq_n_u8(1);
+  size_t i = 0;
+  for (; i + 16 <= end; i += 16) {
+    uint8x16_t hits = vandq_u8(
+        vceqq_u8(vld1q_u8(data + i + 2), one),
+        vandq_u8(vceqq_u8(vld1q_u8(data + i), zero),
+                 vceqq_u8(vld1q_u8(data + i + 1), zero)));
+    uint8x8_t folded = vorr_u8(vget_low_u8(hits), vget_high_u8(hits));
+    if (vget_lane_u64(vreinterpret_u64_u8(folded), 0) == 0)
+      continue;
+    // Hits are rare, let the scalar loop sort out the exact positions.
+    FindStartCodesScalar(data, i, i + 16, collector);
+  }
+  FindStartCodesScalar(data, i, end, collector);
+}
+
+#endif
+
+}  // namespace
+
+NalUnitScanResult::NalUnitScanResult()
+    : has_idr(false), has_sps(false), has_pps(false) {
+  units.reserve(kInitialNalUnitCapacity);
+}
+
+void NalUnitScanResult::Clear() {
+  units.clear();
+  has_idr = false;
+  has_sps = false;
+  has_pps = false;
+}
+
+void ScanNalUnits(const uint8_t* data, size_t size, NalUnitScanResult* result) {
+  NalUnitCollector collector(data, size, result);
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+  static const bool has_avx2 = CpuSupportsAvx2();
+  if (has_avx2)
+    FindStartCodesAvx2(data, collector.search_end(), &collector);
+  else
+    FindStartCodesSse2(data, collector.search_end(), &collector);
+#elif defined(WEBRTC_HAS_NEON)
+  FindStartCodesNeon(data, collector.search_end(), &collector);
+#else
+  FindStartCodesScalar(data, 0, collector.search_end(), &collector);
+#endif
+  collector.Finish();
+}
+
+void ScanNalUnitsScalar(const uint8_t* data,
+                        size_t size,
+                        NalUnitScanResult* result) {
+  NalUnitCollector collector(data, size, result);
+  FindStartCodesScalar(data, 0, collector.search_end(), &collector);
+  collector.Finish();
+}
+
+}  // namespace webrtc
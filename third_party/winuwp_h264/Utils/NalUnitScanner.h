@@ -0,0 +1,55 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#ifndef THIRD_PARTY_H264_WINUWP_UTILS_NALUNITSCANNER_H_
+#define THIRD_PARTY_H264_WINUWP_UTILS_NALUNITSCANNER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace webrtc {
+
+// A single NAL unit found in an Annex-B byte stream. |offset| points past
+// the start code, |length| runs up to the next start code (or to the end
+// of the buffer for the last unit).
+struct NalUnit {
+  size_t offset;
+  size_t length;
+  uint8_t type;
+};
+
+// Result of splitting an encoded frame into NAL units. Meant to be kept
+// around and reused so the fragment table does not reallocate per frame.
+struct NalUnitScanResult {
+  NalUnitScanResult();
+
+  void Clear();
+
+  std::vector<NalUnit> units;
+  bool has_idr;
+  bool has_sps;
+  bool has_pps;
+};
+
+// Splits an Annex-B byte stream into NAL units, using the widest SIMD
+// kernel available on the running CPU. Access unit delimiters are not
+// treated as fragment boundaries, so they stay attached to the previous
+// unit, matching what the encoder has always sent.
+void ScanNalUnits(const uint8_t* data, size_t size, NalUnitScanResult* result);
+
+// Byte-at-a-time reference implementation of ScanNalUnits().
+void ScanNalUnitsScalar(const uint8_t* data,
+                        size_t size,
+                        NalUnitScanResult* result);
+
+}  // namespace webrtc
+
+#endif  // THIRD_PARTY_H264_WINUWP_UTILS_NALUNITSCANNER_H_
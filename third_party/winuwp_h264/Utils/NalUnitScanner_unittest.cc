@@ -0,0 +1,199 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#include "third_party/winuwp_h264/Utils/NalUnitScanner.h"
+
+#include <stdio.h>
+#include <random>
+#include <vector>
+#include "rtc_base/timeutils.h"
+#include "test/gtest.h"
+
+namespace webrtc {
+
+namespace {
+
+// The fragmentation loop the encoder used before ScanNalUnits(), kept
+// verbatim (modulo the output type) as the reference the scanner has to
+// match byte for byte. Only valid for |size| > 5.
+void ScanLegacy(const uint8_t* data, size_t size, NalUnitScanResult* result) {
+  result->Clear();
+  std::vector<NalUnit>& units = result->units;
+  for (uint32_t i = 0; i < size - 5; ++i) {
+    const uint8_t* ptr = data + i;
+    int prefixLengthFound = 0;
+    if (ptr[0] == 0x00 && ptr[1] == 0x00 && ptr[2] == 0x00 && ptr[3] == 0x01
+      && ((ptr[4] & 0x1f) != 0x09 /* ignore access unit delimiters */)) {
+      prefixLengthFound = 4;
+    } else if (ptr[0] == 0x00 && ptr[1] == 0x00 && ptr[2] == 0x01
+      && ((ptr[3] & 0x1f) != 0x09 /* ignore access unit delimiters */)) {
+      prefixLengthFound = 3;
+    }
+
+    if (prefixLengthFound > 0) {
+      uint8_t type = ptr[prefixLengthFound] & 0x1f;
+      if (type == 0x05)
+        result->has_idr = true;
+      else if (type == 0x07)
+        result->has_sps = true;
+      else if (type == 0x08)
+        result->has_pps = true;
+      if (!units.empty())
+        units.back().length = i - units.back().offset;
+      NalUnit unit;
+      unit.offset = i + prefixLengthFound;
+      unit.length = 0;
+      unit.type = type;
+      units.push_back(unit);
+      i += 5;
+    }
+  }
+  if (!units.empty())
+    units.back().length = size - units.back().offset;
+}
+
+void ExpectSameUnits(const NalUnitScanResult& expected,
+                     const NalUnitScanResult& actual) {
+  ASSERT_EQ(expected.units.size(), actual.units.size());
+  for (size_t i = 0; i < expected.units.size(); ++i) {
+    EXPECT_EQ(expected.units[i].offset, actual.units[i].offset) << i;
+    EXPECT_EQ(expected.units[i].length, actual.units[i].length) << i;
+    EXPECT_EQ(expected.units[i].type, actual.units[i].type) << i;
+  }
+  EXPECT_EQ(expected.has_idr, actual.has_idr);
+  EXPECT_EQ(expected.has_sps, actual.has_sps);
+  EXPECT_EQ(expected.has_pps, actual.has_pps);
+}
+
+// Random payload dense in zero bytes, with start codes (3 and 4 byte,
+// some of them AUDs) sprinkled in, so every kernel boundary case shows up.
+std::vector<uint8_t> MakeStream(std::mt19937* rng, size_t size) {
+  std::vector<uint8_t> stream(size);
+  std::uniform_int_distribution<int> byte(0, 255);
+  std::uniform_int_distribution<int> pick(0, 15);
+  for (size_t i = 0; i < size; ++i)
+    stream[i] = pick(*rng) < 6 ? 0x00 : static_cast<uint8_t>(byte(*rng));
+  static const uint8_t kTypes[] = {0x09, 0x07, 0x08, 0x05, 0x01, 0x06};
+  for (size_t i = 0; i + 5 < size; i += 1 + pick(*rng) * 4) {
+    if (pick(*rng) < 10)
+      continue;
+    size_t pos = i;
+    if (pick(*rng) < 8)
+      stream[pos++] = 0x00;
+    stream[pos] = 0x00;
+    stream[pos + 1] = 0x00;
+    stream[pos + 2] = 0x01;
+    stream[pos + 3] = kTypes[pick(*rng) % 6] | 0x60;
+  }
+  return stream;
+}
+
+}  // namespace
+
+TEST(NalUnitScannerTest, SplitsTypicalKeyFrame) {
+  const uint8_t kFrame[] = {
+      0x00, 0x00, 0x00, 0x01, 0x09, 0xf0,                    // AUD
+      0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0xc0, 0x1f,        // SPS
+      0x00, 0x00, 0x00, 0x01, 0x68, 0xce, 0x3c, 0x80,        // PPS
+      0x00, 0x00, 0x01, 0x65, 0x88, 0x84, 0x00, 0x33, 0xff,  // IDR
+  };
+  NalUnitScanResult result;
+  ScanNalUnits(kFrame, sizeof(kFrame), &result);
+
+  // The leading AUD is skipped, so the first unit is the SPS.
+  ASSERT_EQ(3u, result.units.size());
+  EXPECT_EQ(10u, result.units[0].offset);
+  EXPECT_EQ(4u, result.units[0].length);
+  EXPECT_EQ(0x07, result.units[0].type);
+  EXPECT_EQ(18u, result.units[1].offset);
+  EXPECT_EQ(4u, result.units[1].length);
+  EXPECT_EQ(0x08, result.units[1].type);
+  EXPECT_EQ(25u, result.units[2].offset);
+  EXPECT_EQ(sizeof(kFrame) - 25, result.units[2].length);
+  EXPECT_EQ(0x05, result.units[2].type);
+  EXPECT_TRUE(result.has_idr);
+  EXPECT_TRUE(result.has_sps);
+  EXPECT_TRUE(result.has_pps);
+}
+
+TEST(NalUnitScannerTest, ShortInputsHaveNoUnits) {
+  const uint8_t kShort[] = {0x00, 0x00, 0x00, 0x01, 0x65};
+  NalUnitScanResult result;
+  for (size_t size = 0; size <= sizeof(kShort); ++size) {
+    ScanNalUnits(kShort, size, &result);
+    EXPECT_TRUE(result.units.empty()) << size;
+    EXPECT_FALSE(result.has_idr);
+  }
+}
+
+TEST(NalUnitScannerTest, MatchesLegacyLoop) {
+  std::mt19937 rng(1234);
+  NalUnitScanResult expected;
+  NalUnitScanResult scalar;
+  NalUnitScanResult simd;
+  // Sizes around the 16 and 32 byte vector widths, then larger ones.
+  for (size_t size = 6; size < 2048; size += size < 80 ? 1 : 37) {
+    for (int round = 0; round < 8; ++round) {
+      std::vector<uint8_t> stream = MakeStream(&rng, size);
+      ScanLegacy(stream.data(), stream.size(), &expected);
+      ScanNalUnitsScalar(stream.data(), stream.size(), &scalar);
+      ScanNalUnits(stream.data(), stream.size(), &simd);
+      SCOPED_TRACE(size);
+      ExpectSameUnits(expected, scalar);
+      ExpectSameUnits(expected, simd);
+    }
+  }
+}
+
+TEST(NalUnitScannerTest, MatchesLegacyLoopOnZeroRuns) {
+  // Long zero runs are the worst case for the candidate masks.
+  for (size_t size = 6; size < 200; ++size) {
+    for (size_t pos = 0; pos + 4 <= size; ++pos) {
+      std::vector<uint8_t> stream(size, 0x00);
+      stream[pos] = 0x01;
+      if (pos + 1 < size)
+        stream[pos + 1] = 0x41;
+      NalUnitScanResult expected;
+      NalUnitScanResult simd;
+      ScanLegacy(stream.data(), stream.size(), &expected);
+      ScanNalUnits(stream.data(), stream.size(), &simd);
+      SCOPED_TRACE(size);
+      SCOPED_TRACE(pos);
+      ExpectSameUnits(expected, simd);
+    }
+  }
+}
+
+// Not a pass/fail test: prints the throughput of the dispatched kernel and
+// the legacy loop over a 1080p-sized key frame.
+TEST(NalUnitScannerTest, Throughput) {
+  const size_t kFrameSize = 256 * 1024;
+  const int kIterations = 200;
+  std::mt19937 rng(42);
+  std::vector<uint8_t> stream = MakeStream(&rng, kFrameSize);
+  NalUnitScanResult result;
+
+  int64_t start_ns = rtc::TimeNanos();
+  for (int i = 0; i < kIterations; ++i)
+    ScanLegacy(stream.data(), stream.size(), &result);
+  int64_t legacy_ns = rtc::TimeNanos() - start_ns;
+
+  start_ns = rtc::TimeNanos();
+  for (int i = 0; i < kIterations; ++i)
+    ScanNalUnits(stream.data(), stream.size(), &result);
+  int64_t simd_ns = rtc::TimeNanos() - start_ns;
+
+  double bytes = static_cast<double>(kFrameSize) * kIterations;
+  printf("NalUnitScanner: legacy %.0f MB/s, ScanNalUnits %.0f MB/s\n",
+         bytes * 1000 / (legacy_ns + 1), bytes * 1000 / (simd_ns + 1));
+  EXPECT_FALSE(result.units.empty());
+}
+
+}  // namespace webrtc
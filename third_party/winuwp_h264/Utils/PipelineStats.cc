@@ -0,0 +1,177 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#include "third_party/winuwp_h264/Utils/PipelineStats.h"
+
+#include <algorithm>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace webrtc {
+
+namespace {
+
+inline int CountLeadingZeros(uint32_t value) {
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long index;
+  _BitScanReverse(&index, value);
+  return 31 - static_cast<int>(index);
+#else
+  return __builtin_clz(value);
+#endif
+}
+
+inline int BucketIndex(int64_t latency_us) {
+  if (latency_us <= 0)
+    return 0;
+  uint32_t value = static_cast<uint32_t>(
+      std::min<int64_t>(latency_us, INT32_MAX));
+  return 32 - CountLeadingZeros(value);
+}
+
+// Raises |target| to |value| if it is lower.
+template <typename T>
+inline void StoreMax(std::atomic<T>* target, T value) {
+  T current = target->load(std::memory_order_relaxed);
+  while (current < value &&
+         !target->compare_exchange_weak(current, value,
+                                        std::memory_order_relaxed)) {
+  }
+}
+
+}  // namespace
+
+LatencyHistogram::LatencyHistogram() : sum_us_(0), max_us_(0) {
+  for (auto& bucket : buckets_)
+    bucket.store(0, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::Add(int64_t latency_us) {
+  // The clock may step backwards between two readings.
+  latency_us = std::max<int64_t>(latency_us, 0);
+  buckets_[BucketIndex(latency_us)].fetch_add(1, std::memory_order_relaxed);
+  sum_us_.fetch_add(static_cast<uint64_t>(latency_us),
+                    std::memory_order_relaxed);
+  StoreMax(&max_us_, latency_us);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::GetSnapshot() const {
+  Snapshot snapshot;
+  // The count is the sum of the buckets, so percentiles stay consistent
+  // with it while samples are being added.
+  for (int i = 0; i < kNumBuckets; ++i) {
+    snapshot.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+    snapshot.count += snapshot.buckets[i];
+  }
+  snapshot.sum_us = sum_us_.load(std::memory_order_relaxed);
+  snapshot.max_us = max_us_.load(std::memory_order_relaxed);
+  return snapshot;
+}
+
+int64_t LatencyHistogram::Snapshot::mean_us() const {
+  return count == 0 ? 0 : static_cast<int64_t>(sum_us / count);
+}
+
+int64_t LatencyHistogram::Snapshot::Percentile(double percentile) const {
+  if (count == 0)
+    return 0;
+  double rank = std::max(1.0, count * std::min(percentile, 100.0) / 100.0);
+  uint64_t seen = 0;
+  for (int i = 0; i < kNumBuckets; ++i) {
+    seen += buckets[i];
+    if (seen >= rank) {
+      int64_t upper = i == 0 ? 0 : (int64_t{1} << i) - 1;
+      return std::min(upper, max_us);
+    }
+  }
+  return max_us;
+}
+
+PipelineStats::PipelineStats()
+    : frames_in_(0),
+      frames_out_(0),
+      in_flight_(0),
+      max_in_flight_(0),
+      reinits_(0),
+      bytes_copied_(0) {
+  for (auto& drops : drops_)
+    drops.store(0, std::memory_order_relaxed);
+}
+
+void PipelineStats::SetInFlight(int depth) {
+  in_flight_.store(depth, std::memory_order_relaxed);
+  StoreMax(&max_in_flight_, depth);
+}
+
+PipelineStats::Snapshot PipelineStats::GetSnapshot() const {
+  Snapshot snapshot;
+  for (int i = 0; i < kNumStages; ++i)
+    snapshot.stages[i] = stages_[i].GetSnapshot();
+  for (int i = 0; i < kNumDropReasons; ++i)
+    snapshot.drops[i] = drops_[i].load(std::memory_order_relaxed);
+  snapshot.frames_in = frames_in_.load(std::memory_order_relaxed);
+  snapshot.frames_out = frames_out_.load(std::memory_order_relaxed);
+  snapshot.in_flight = in_flight_.load(std::memory_order_relaxed);
+  snapshot.max_in_flight = max_in_flight_.load(std::memory_order_relaxed);
+  snapshot.reinits = reinits_.load(std::memory_order_relaxed);
+  snapshot.bytes_copied = bytes_copied_.load(std::memory_order_relaxed);
+  return snapshot;
+}
+
+uint64_t PipelineStats::Snapshot::total_drops() const {
+  uint64_t total = 0;
+  for (uint64_t count : drops)
+    total += count;
+  return total;
+}
+
+const char* PipelineStats::StageName(Stage stage) {
+  switch (stage) {
+    case kConversion:
+      return "conversion";
+    case kQueueing:
+      return "queueing";
+    case kCodec:
+      return "codec";
+    case kCallback:
+      return "callback";
+    default:
+      return "unknown";
+  }
+}
+
+const char* PipelineStats::DropReasonName(DropReason reason) {
+  switch (reason) {
+    case kDropPendingLimit:
+      return "pending_limit";
+    case kDropConversionFailed:
+      return "conversion_failed";
+    case kDropCodecError:
+      return "codec_error";
+    case kDropEmptyOutput:
+      return "empty_output";
+    case kDropMissingAttributes:
+      return "missing_attributes";
+    case kDropAttributeQueueFull:
+      return "attribute_queue_full";
+    case kDropNoCallback:
+      return "no_callback";
+    case kDropWaitingForKeyFrame:
+      return "waiting_for_key_frame";
+    case kDropBufferUnavailable:
+      return "buffer_unavailable";
+    default:
+      return "unknown";
+  }
+}
+
+}  // namespace webrtc
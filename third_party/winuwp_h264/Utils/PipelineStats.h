@@ -0,0 +1,146 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#ifndef THIRD_PARTY_H264_WINUWP_UTILS_PIPELINESTATS_H_
+#define THIRD_PARTY_H264_WINUWP_UTILS_PIPELINESTATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+namespace webrtc {
+
+// Histogram of latencies in microseconds with power-of-two buckets.
+// Add() is wait-free and may be called from any thread; a snapshot taken
+// concurrently may be off by the samples added while it was taken.
+class LatencyHistogram {
+ public:
+  // Bucket 0 holds 0 us, bucket i the range [2^(i-1), 2^i) us. The last
+  // bucket also takes everything above 2^31 us.
+  static const int kNumBuckets = 32;
+
+  struct Snapshot {
+    uint64_t count = 0;
+    uint64_t sum_us = 0;
+    int64_t max_us = 0;
+    uint64_t buckets[kNumBuckets] = {};
+
+    int64_t mean_us() const;
+    // Upper bound of the bucket holding the given percentile (0 to 100),
+    // capped at |max_us|. 0 when empty.
+    int64_t Percentile(double percentile) const;
+  };
+
+  LatencyHistogram();
+
+  void Add(int64_t latency_us);
+  Snapshot GetSnapshot() const;
+
+ private:
+  std::atomic<uint64_t> buckets_[kNumBuckets];
+  std::atomic<uint64_t> sum_us_;
+  std::atomic<int64_t> max_us_;
+
+  LatencyHistogram(const LatencyHistogram&) = delete;
+  LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+};
+
+// Per-frame counters shared by the encoder and the decoder. All updates
+// are relaxed atomics, so the hot path never takes a lock.
+class PipelineStats {
+ public:
+  enum Stage {
+    // Copying or converting between WebRTC and Media Foundation buffers.
+    kConversion,
+    // Time the Media Foundation entry point blocks accepting a sample.
+    kQueueing,
+    // From submission to Media Foundation until the output shows up,
+    // including time queued inside the transform.
+    kCodec,
+    // Time spent in the WebRTC completion callback.
+    kCallback,
+    kNumStages
+  };
+
+  enum DropReason {
+    // Encoder: too many frames in flight.
+    kDropPendingLimit,
+    // Input could not be copied into a Media Foundation sample.
+    kDropConversionFailed,
+    // Media Foundation rejected the frame or failed to produce output.
+    kDropCodecError,
+    // Encoder: output sample without payload.
+    kDropEmptyOutput,
+    // Encoder: no cached attributes for the output timestamp.
+    kDropMissingAttributes,
+    // Encoder: no room to cache the attributes of an input frame.
+    kDropAttributeQueueFull,
+    // Output produced while no callback was registered.
+    kDropNoCallback,
+    // Decoder: delta frame received while waiting for a key frame.
+    kDropWaitingForKeyFrame,
+    // Decoder: the output could not be mapped or no buffer was available.
+    kDropBufferUnavailable,
+    kNumDropReasons
+  };
+
+  struct Snapshot {
+    LatencyHistogram::Snapshot stages[kNumStages];
+    uint64_t drops[kNumDropReasons] = {};
+    uint64_t frames_in = 0;
+    uint64_t frames_out = 0;
+    // Frames submitted but not yet returned by Media Foundation.
+    int in_flight = 0;
+    int max_in_flight = 0;
+    // Times the Media Foundation pipeline was rebuilt or flushed.
+    uint64_t reinits = 0;
+    uint64_t bytes_copied = 0;
+
+    uint64_t total_drops() const;
+  };
+
+  PipelineStats();
+
+  void AddLatency(Stage stage, int64_t latency_us) {
+    stages_[stage].Add(latency_us);
+  }
+  void OnFrameIn() { frames_in_.fetch_add(1, std::memory_order_relaxed); }
+  void OnFrameOut() { frames_out_.fetch_add(1, std::memory_order_relaxed); }
+  void OnFrameDropped(DropReason reason) {
+    drops_[reason].fetch_add(1, std::memory_order_relaxed);
+  }
+  void OnReinit() { reinits_.fetch_add(1, std::memory_order_relaxed); }
+  void AddBytesCopied(size_t bytes) {
+    bytes_copied_.fetch_add(bytes, std::memory_order_relaxed);
+  }
+  void SetInFlight(int depth);
+
+  Snapshot GetSnapshot() const;
+
+  static const char* StageName(Stage stage);
+  static const char* DropReasonName(DropReason reason);
+
+ private:
+  LatencyHistogram stages_[kNumStages];
+  std::atomic<uint64_t> drops_[kNumDropReasons];
+  std::atomic<uint64_t> frames_in_;
+  std::atomic<uint64_t> frames_out_;
+  std::atomic<int> in_flight_;
+  std::atomic<int> max_in_flight_;
+  std::atomic<uint64_t> reinits_;
+  std::atomic<uint64_t> bytes_copied_;
+
+  PipelineStats(const PipelineStats&) = delete;
+  PipelineStats& operator=(const PipelineStats&) = delete;
+};
+
+}  // namespace webrtc
+
+#endif  // THIRD_PARTY_H264_WINUWP_UTILS_PIPELINESTATS_H_
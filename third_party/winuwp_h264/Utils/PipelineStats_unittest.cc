@@ -0,0 +1,177 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#include "third_party/winuwp_h264/Utils/PipelineStats.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+#include "rtc_base/timeutils.h"
+#include "test/gtest.h"
+
+namespace webrtc {
+
+TEST(LatencyHistogramTest, EmptySnapshot) {
+  LatencyHistogram histogram;
+  LatencyHistogram::Snapshot snapshot = histogram.GetSnapshot();
+  EXPECT_EQ(0u, snapshot.count);
+  EXPECT_EQ(0, snapshot.mean_us());
+  EXPECT_EQ(0, snapshot.Percentile(50));
+  EXPECT_EQ(0, snapshot.max_us);
+}
+
+TEST(LatencyHistogramTest, PowerOfTwoBuckets) {
+  LatencyHistogram histogram;
+  histogram.Add(0);
+  histogram.Add(1);
+  histogram.Add(2);
+  histogram.Add(3);
+  histogram.Add(1000);
+  // Clamped to 0.
+  histogram.Add(-5);
+  // Lands in the last bucket.
+  histogram.Add(int64_t{1} << 40);
+
+  LatencyHistogram::Snapshot snapshot = histogram.GetSnapshot();
+  EXPECT_EQ(7u, snapshot.count);
+  EXPECT_EQ(2u, snapshot.buckets[0]);
+  EXPECT_EQ(1u, snapshot.buckets[1]);
+  EXPECT_EQ(2u, snapshot.buckets[2]);
+  // 512 <= 1000 < 1024.
+  EXPECT_EQ(1u, snapshot.buckets[10]);
+  EXPECT_EQ(1u, snapshot.buckets[LatencyHistogram::kNumBuckets - 1]);
+  EXPECT_EQ(int64_t{1} << 40, snapshot.max_us);
+}
+
+TEST(LatencyHistogramTest, MeanAndPercentiles) {
+  LatencyHistogram histogram;
+  for (int i = 0; i < 90; ++i)
+    histogram.Add(100);
+  for (int i = 0; i < 10; ++i)
+    histogram.Add(5000);
+
+  LatencyHistogram::Snapshot snapshot = histogram.GetSnapshot();
+  EXPECT_EQ(100u, snapshot.count);
+  EXPECT_EQ((90 * 100 + 10 * 5000) / 100, snapshot.mean_us());
+  // Upper bounds of the buckets, [64, 128) and [4096, 8192).
+  EXPECT_EQ(127, snapshot.Percentile(50));
+  EXPECT_EQ(127, snapshot.Percentile(90));
+  // Capped at the maximum seen.
+  EXPECT_EQ(5000, snapshot.Percentile(95));
+  EXPECT_EQ(5000, snapshot.Percentile(100));
+  EXPECT_EQ(5000, snapshot.Percentile(150));
+}
+
+TEST(PipelineStatsTest, CountsEvents) {
+  PipelineStats stats;
+  stats.OnFrameIn();
+  stats.OnFrameIn();
+  stats.OnFrameIn();
+  stats.OnFrameOut();
+  stats.OnFrameDropped(PipelineStats::kDropPendingLimit);
+  stats.OnFrameDropped(PipelineStats::kDropPendingLimit);
+  stats.OnFrameDropped(PipelineStats::kDropCodecError);
+  stats.OnReinit();
+  stats.AddBytesCopied(1000);
+  stats.AddBytesCopied(24);
+  stats.SetInFlight(3);
+  stats.SetInFlight(1);
+  stats.AddLatency(PipelineStats::kCodec, 40);
+
+  PipelineStats::Snapshot snapshot = stats.GetSnapshot();
+  EXPECT_EQ(3u, snapshot.frames_in);
+  EXPECT_EQ(1u, snapshot.frames_out);
+  EXPECT_EQ(2u, snapshot.drops[PipelineStats::kDropPendingLimit]);
+  EXPECT_EQ(1u, snapshot.drops[PipelineStats::kDropCodecError]);
+  EXPECT_EQ(3u, snapshot.total_drops());
+  EXPECT_EQ(1u, snapshot.reinits);
+  EXPECT_EQ(1024u, snapshot.bytes_copied);
+  EXPECT_EQ(1, snapshot.in_flight);
+  EXPECT_EQ(3, snapshot.max_in_flight);
+  EXPECT_EQ(1u, snapshot.stages[PipelineStats::kCodec].count);
+  EXPECT_EQ(0u, snapshot.stages[PipelineStats::kConversion].count);
+}
+
+TEST(PipelineStatsTest, EveryEnumHasAName) {
+  for (int i = 0; i < PipelineStats::kNumStages; ++i) {
+    EXPECT_STRNE("unknown", PipelineStats::StageName(
+                                static_cast<PipelineStats::Stage>(i)));
+  }
+  for (int i = 0; i < PipelineStats::kNumDropReasons; ++i) {
+    EXPECT_STRNE("unknown",
+                 PipelineStats::DropReasonName(
+                     static_cast<PipelineStats::DropReason>(i)));
+  }
+}
+
+// The encoder adds from the encode thread and the Media Foundation
+// callback thread at once; nothing may get lost.
+TEST(PipelineStatsTest, ConcurrentUpdates) {
+  const int kThreads = 4;
+  const int kSamples = 100000;
+  PipelineStats stats;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&stats, t] {
+      for (int i = 0; i < kSamples; ++i) {
+        stats.AddLatency(PipelineStats::kCodec, i % 2000);
+        stats.OnFrameIn();
+        stats.SetInFlight(t + 1);
+      }
+    });
+  }
+  for (std::thread& thread : threads)
+    thread.join();
+
+  PipelineStats::Snapshot snapshot = stats.GetSnapshot();
+  EXPECT_EQ(uint64_t{kThreads} * kSamples, snapshot.frames_in);
+  EXPECT_EQ(uint64_t{kThreads} * kSamples,
+            snapshot.stages[PipelineStats::kCodec].count);
+  EXPECT_EQ(1999, snapshot.stages[PipelineStats::kCodec].max_us);
+  EXPECT_EQ(kThreads, snapshot.max_in_flight);
+}
+
+// Not a pass/fail test: prints what a sample costs on the hot path, alone
+// and with the encoder and callback threads adding at the same time.
+TEST(PipelineStatsTest, AddLatencyCost) {
+  const int kSamples = 2000000;
+  PipelineStats stats;
+
+  int64_t start_ns = rtc::TimeNanos();
+  for (int i = 0; i < kSamples; ++i)
+    stats.AddLatency(PipelineStats::kCodec, i & 0xffff);
+  int64_t single_ns = rtc::TimeNanos() - start_ns;
+
+  start_ns = rtc::TimeNanos();
+  std::thread other([&stats] {
+    for (int i = 0; i < kSamples; ++i)
+      stats.AddLatency(PipelineStats::kCodec, i & 0xffff);
+  });
+  for (int i = 0; i < kSamples; ++i)
+    stats.AddLatency(PipelineStats::kCodec, i & 0xffff);
+  other.join();
+  int64_t contended_ns = rtc::TimeNanos() - start_ns;
+
+  start_ns = rtc::TimeNanos();
+  const int kSnapshots = 10000;
+  uint64_t total = 0;
+  for (int i = 0; i < kSnapshots; ++i)
+    total += stats.GetSnapshot().frames_in;
+  int64_t snapshot_ns = rtc::TimeNanos() - start_ns;
+
+  EXPECT_EQ(0u, total);
+  printf("AddLatency: %.1f ns, %.1f ns with 2 threads; GetSnapshot: %.0f ns\n",
+         static_cast<double>(single_ns) / kSamples,
+         static_cast<double>(contended_ns) / kSamples,
+         static_cast<double>(snapshot_ns) / kSnapshots);
+}
+
+}  // namespace webrtc
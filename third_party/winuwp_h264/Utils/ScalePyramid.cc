@@ -0,0 +1,100 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#include "third_party/winuwp_h264/Utils/ScalePyramid.h"
+
+#include <stdlib.h>
+#include <algorithm>
+#include "api/video/i420_buffer.h"
+
+namespace webrtc {
+
+namespace {
+
+// Scaled buffers still owned by the encoders before they are recycled.
+const size_t kMaxBuffersPerLevel = 4;
+
+// True when |source| covers |width| x |height| with (almost) the same
+// aspect ratio, so cropping it gives the same picture as cropping the
+// original frame.
+bool CanScaleFrom(const I420BufferInterface& source, int width, int height) {
+  if (source.width() < width || source.height() < height)
+    return false;
+  int64_t a = static_cast<int64_t>(source.width()) * height;
+  int64_t b = static_cast<int64_t>(source.height()) * width;
+  return std::abs(a - b) * 100 <= a;
+}
+
+}  // namespace
+
+ScalePyramid::ScalePyramid() {}
+
+ScalePyramid::~ScalePyramid() {}
+
+void ScalePyramid::Configure(const std::vector<Level>& levels) {
+  levels_ = levels;
+  order_.resize(levels_.size());
+  pools_.clear();
+  for (size_t i = 0; i < levels_.size(); ++i) {
+    order_[i] = i;
+    pools_.emplace_back(new I420BufferPool(false, kMaxBuffersPerLevel));
+  }
+  std::stable_sort(order_.begin(), order_.end(), [this](size_t a, size_t b) {
+    return levels_[a].width * levels_[a].height >
+           levels_[b].width * levels_[b].height;
+  });
+}
+
+bool ScalePyramid::Scale(
+    const rtc::scoped_refptr<VideoFrameBuffer>& input,
+    uint32_t level_mask,
+    std::vector<rtc::scoped_refptr<VideoFrameBuffer>>* output) {
+  output->assign(levels_.size(), nullptr);
+  bool complete = true;
+
+  // Converted at most once, and only if some level needs scaling.
+  rtc::scoped_refptr<I420BufferInterface> input_i420;
+  // Levels scaled so far, largest first.
+  std::vector<rtc::scoped_refptr<I420Buffer>> scaled;
+
+  for (size_t index : order_) {
+    if ((level_mask & (1u << index)) == 0)
+      continue;
+    const Level& level = levels_[index];
+    if (level.width == input->width() && level.height == input->height()) {
+      (*output)[index] = input;
+      continue;
+    }
+
+    const I420BufferInterface* source = nullptr;
+    for (const auto& candidate : scaled) {
+      if (CanScaleFrom(*candidate, level.width, level.height))
+        source = candidate.get();
+    }
+    if (source == nullptr) {
+      if (!input_i420)
+        input_i420 = input->ToI420();
+      source = input_i420.get();
+    }
+
+    rtc::scoped_refptr<I420Buffer> buffer =
+        pools_[index]->CreateBuffer(level.width, level.height);
+    if (!buffer) {
+      complete = false;
+      continue;
+    }
+    buffer->CropAndScaleFrom(*source);
+    (*output)[index] = buffer;
+    scaled.push_back(buffer);
+  }
+  return complete;
+}
+
+}  // namespace webrtc
@@ -0,0 +1,60 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#ifndef THIRD_PARTY_H264_WINUWP_UTILS_SCALEPYRAMID_H_
+#define THIRD_PARTY_H264_WINUWP_UTILS_SCALEPYRAMID_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <vector>
+#include "api/video/video_frame_buffer.h"
+#include "common_video/include/i420_buffer_pool.h"
+#include "rtc_base/scoped_ref_ptr.h"
+
+namespace webrtc {
+
+// Scales one captured frame to several layer sizes. Each level is scaled
+// from the smallest already produced level that is still large enough,
+// so e.g. a quarter size layer is made from the half size one instead of
+// the full frame. A level matching the input size gets the input buffer
+// itself, keeping native buffers native. Not thread safe.
+class ScalePyramid {
+ public:
+  struct Level {
+    int width;
+    int height;
+  };
+
+  ScalePyramid();
+  ~ScalePyramid();
+
+  // Levels may come in any order; Scale() reports them in this order.
+  void Configure(const std::vector<Level>& levels);
+
+  size_t num_levels() const { return levels_.size(); }
+
+  // Produces the levels whose bit is set in |level_mask|. |output| gets
+  // one entry per level, null for levels not requested or for which no
+  // buffer was available. Returns false in the latter case.
+  bool Scale(const rtc::scoped_refptr<VideoFrameBuffer>& input,
+             uint32_t level_mask,
+             std::vector<rtc::scoped_refptr<VideoFrameBuffer>>* output);
+
+ private:
+  std::vector<Level> levels_;
+  // Level indices, largest area first.
+  std::vector<size_t> order_;
+  std::vector<std::unique_ptr<I420BufferPool>> pools_;
+};
+
+}  // namespace webrtc
+
+#endif  // THIRD_PARTY_H264_WINUWP_UTILS_SCALEPYRAMID_H_
@@ -0,0 +1,164 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#include "third_party/winuwp_h264/Utils/ScalePyramid.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "api/video/i420_buffer.h"
+#include "rtc_base/timeutils.h"
+#include "test/gtest.h"
+#include "third_party/winuwp_h264/Utils/SimulcastLayerScheduler.h"
+
+namespace webrtc {
+
+namespace {
+
+typedef std::vector<rtc::scoped_refptr<VideoFrameBuffer>> LevelBuffers;
+
+rtc::scoped_refptr<I420Buffer> SolidFrame(int width, int height) {
+  rtc::scoped_refptr<I420Buffer> buffer = I420Buffer::Create(width, height);
+  memset(buffer->MutableDataY(), 100, buffer->StrideY() * height);
+  memset(buffer->MutableDataU(), 50, buffer->StrideU() * ((height + 1) / 2));
+  memset(buffer->MutableDataV(), 200, buffer->StrideV() * ((height + 1) / 2));
+  return buffer;
+}
+
+void ExpectSolid(const rtc::scoped_refptr<VideoFrameBuffer>& buffer) {
+  rtc::scoped_refptr<I420BufferInterface> i420 = buffer->ToI420();
+  for (int row = 0; row < i420->height(); ++row) {
+    for (int col = 0; col < i420->width(); ++col)
+      ASSERT_EQ(100, i420->DataY()[row * i420->StrideY() + col]);
+  }
+  for (int row = 0; row < (i420->height() + 1) / 2; ++row) {
+    for (int col = 0; col < (i420->width() + 1) / 2; ++col) {
+      ASSERT_EQ(50, i420->DataU()[row * i420->StrideU() + col]);
+      ASSERT_EQ(200, i420->DataV()[row * i420->StrideV() + col]);
+    }
+  }
+}
+
+}  // namespace
+
+TEST(ScalePyramidTest, ScalesEveryRequestedLevel) {
+  ScalePyramid pyramid;
+  // Out of order on purpose, output follows the configured order.
+  pyramid.Configure({{320, 180}, {1280, 720}, {640, 360}});
+  ASSERT_EQ(3u, pyramid.num_levels());
+
+  rtc::scoped_refptr<VideoFrameBuffer> input = SolidFrame(1280, 720);
+  LevelBuffers output;
+  EXPECT_TRUE(pyramid.Scale(input, 0x7, &output));
+  ASSERT_EQ(3u, output.size());
+  // The full size level is the input itself.
+  EXPECT_EQ(input.get(), output[1].get());
+  ASSERT_TRUE(output[0]);
+  ASSERT_TRUE(output[2]);
+  EXPECT_EQ(320, output[0]->width());
+  EXPECT_EQ(180, output[0]->height());
+  EXPECT_EQ(640, output[2]->width());
+  EXPECT_EQ(360, output[2]->height());
+  ExpectSolid(output[0]);
+  ExpectSolid(output[2]);
+}
+
+TEST(ScalePyramidTest, SkipsLevelsNotInMask) {
+  ScalePyramid pyramid;
+  pyramid.Configure({{320, 180}, {640, 360}, {1280, 720}});
+  LevelBuffers output;
+  EXPECT_TRUE(pyramid.Scale(SolidFrame(1280, 720), 0x1, &output));
+  ASSERT_EQ(3u, output.size());
+  EXPECT_TRUE(output[0]);
+  EXPECT_FALSE(output[1]);
+  EXPECT_FALSE(output[2]);
+}
+
+// The quality scaler may lower the input below the configured sizes.
+TEST(ScalePyramidTest, InputSmallerThanLevels) {
+  ScalePyramid pyramid;
+  pyramid.Configure({{640, 360}, {1280, 720}});
+  LevelBuffers output;
+  EXPECT_TRUE(pyramid.Scale(SolidFrame(480, 270), 0x3, &output));
+  ASSERT_TRUE(output[0]);
+  ASSERT_TRUE(output[1]);
+  EXPECT_EQ(1280, output[1]->width());
+  ExpectSolid(output[0]);
+  ExpectSolid(output[1]);
+}
+
+TEST(ScalePyramidTest, ReportsExhaustedBufferPool) {
+  ScalePyramid pyramid;
+  pyramid.Configure({{320, 180}, {640, 360}});
+  rtc::scoped_refptr<VideoFrameBuffer> input = SolidFrame(640, 360);
+
+  // The encoders still hold every buffer they got.
+  std::vector<LevelBuffers> held;
+  bool complete = true;
+  for (int i = 0; i < 10 && complete; ++i) {
+    held.emplace_back();
+    complete = pyramid.Scale(input, 0x3, &held.back());
+  }
+  ASSERT_FALSE(complete);
+  EXPECT_FALSE(held.back()[0]);
+  // The pass-through level needs no buffer.
+  EXPECT_EQ(input.get(), held.back()[1].get());
+
+  // Returned buffers are used again.
+  held.clear();
+  LevelBuffers output;
+  EXPECT_TRUE(pyramid.Scale(input, 0x3, &output));
+  EXPECT_TRUE(output[0]);
+}
+
+// Not a pass/fail test: prints the per-frame cost of scheduling and
+// scaling 1080p capture into three simulcast layers, one of them at half
+// the frame rate, against scaling every layer from the full frame.
+TEST(ScalePyramidTest, Throughput) {
+  const int kFrames = 150;
+  const std::vector<ScalePyramid::Level> kLevels = {
+      {480, 270}, {960, 540}, {1920, 1080}};
+  rtc::scoped_refptr<VideoFrameBuffer> input = SolidFrame(1920, 1080);
+
+  SimulcastLayerScheduler scheduler;
+  scheduler.Configure({15, 30, 30});
+  ScalePyramid pyramid;
+  pyramid.Configure(kLevels);
+  std::vector<SimulcastLayerScheduler::LayerTask> tasks;
+  LevelBuffers output;
+  int encoded = 0;
+  int64_t start_us = rtc::TimeMicros();
+  for (int i = 0; i < kFrames; ++i) {
+    uint32_t mask = scheduler.Schedule(i * 1000 / 30, &tasks);
+    pyramid.Scale(input, mask, &output);
+    encoded += static_cast<int>(tasks.size());
+  }
+  int64_t pyramid_us = rtc::TimeMicros() - start_us;
+
+  // Every layer scaled from the full frame, at full frame rate.
+  std::vector<rtc::scoped_refptr<I420Buffer>> direct;
+  for (const ScalePyramid::Level& level : kLevels)
+    direct.push_back(I420Buffer::Create(level.width, level.height));
+  rtc::scoped_refptr<I420BufferInterface> input_i420 = input->ToI420();
+  start_us = rtc::TimeMicros();
+  for (int i = 0; i < kFrames; ++i) {
+    for (size_t level = 0; level + 1 < direct.size(); ++level)
+      direct[level]->CropAndScaleFrom(*input_i420);
+  }
+  int64_t direct_us = rtc::TimeMicros() - start_us;
+
+  EXPECT_EQ(kFrames * 5 / 2, encoded);
+  printf("1080p to 3 layers: %.0f us per frame with scheduler and pyramid, "
+         "%.0f us scaling each layer from the input\n",
+         static_cast<double>(pyramid_us) / kFrames,
+         static_cast<double>(direct_us) / kFrames);
+}
+
+}  // namespace webrtc
@@ -0,0 +1,86 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#include "third_party/winuwp_h264/Utils/SimulcastLayerScheduler.h"
+
+namespace webrtc {
+
+namespace {
+
+// A frame is taken this fraction of an interval early, so capture jitter
+// doesn't push a due frame to the next capture.
+const double kFrameTimeTolerance = 0.25;
+
+}  // namespace
+
+void SimulcastLayerScheduler::Configure(
+    const std::vector<uint32_t>& max_framerates) {
+  layers_.assign(max_framerates.size(), Layer());
+  for (size_t i = 0; i < max_framerates.size(); ++i) {
+    if (max_framerates[i] > 0)
+      layers_[i].interval_ms = 1000.0 / max_framerates[i];
+  }
+}
+
+void SimulcastLayerScheduler::SetLayerActive(size_t layer, bool active) {
+  if (layer >= layers_.size())
+    return;
+  if (active && !layers_[layer].active)
+    layers_[layer].key_frame_pending = true;
+  layers_[layer].active = active;
+}
+
+bool SimulcastLayerScheduler::IsLayerActive(size_t layer) const {
+  return layer < layers_.size() && layers_[layer].active;
+}
+
+void SimulcastLayerScheduler::RequestKeyFrame(size_t layer) {
+  if (layer < layers_.size())
+    layers_[layer].key_frame_pending = true;
+}
+
+void SimulcastLayerScheduler::RequestKeyFrames() {
+  for (Layer& layer : layers_)
+    layer.key_frame_pending = true;
+}
+
+uint32_t SimulcastLayerScheduler::Schedule(int64_t capture_time_ms,
+                                           std::vector<LayerTask>* tasks) {
+  tasks->clear();
+  uint32_t mask = 0;
+  for (size_t i = 0; i < layers_.size(); ++i) {
+    Layer& layer = layers_[i];
+    if (!layer.active)
+      continue;
+
+    if (layer.interval_ms > 0 && layer.has_encoded) {
+      double tolerance = layer.interval_ms * kFrameTimeTolerance;
+      if (capture_time_ms + tolerance < layer.next_frame_ms)
+        continue;
+      layer.next_frame_ms += layer.interval_ms;
+      // Don't try to catch up after a gap in capture.
+      if (layer.next_frame_ms < capture_time_ms)
+        layer.next_frame_ms = capture_time_ms + layer.interval_ms;
+    } else {
+      layer.next_frame_ms = capture_time_ms + layer.interval_ms;
+    }
+    layer.has_encoded = true;
+
+    LayerTask task;
+    task.layer = i;
+    task.key_frame = layer.key_frame_pending;
+    layer.key_frame_pending = false;
+    tasks->push_back(task);
+    mask |= 1u << i;
+  }
+  return mask;
+}
+
+}  // namespace webrtc
@@ -0,0 +1,63 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#ifndef THIRD_PARTY_H264_WINUWP_UTILS_SIMULCASTLAYERSCHEDULER_H_
+#define THIRD_PARTY_H264_WINUWP_UTILS_SIMULCASTLAYERSCHEDULER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace webrtc {
+
+// Decides which simulcast layers encode a captured frame: applies each
+// layer's frame rate limit, skips paused layers and keeps key frame
+// requests pending until the layer encodes again. Not thread safe.
+class SimulcastLayerScheduler {
+ public:
+  struct LayerTask {
+    size_t layer;
+    bool key_frame;
+  };
+
+  // One entry per layer, 0 meaning no frame rate limit. All layers start
+  // active and with a key frame pending.
+  void Configure(const std::vector<uint32_t>& max_framerates);
+
+  size_t num_layers() const { return layers_.size(); }
+
+  // A layer that is resumed starts with a key frame.
+  void SetLayerActive(size_t layer, bool active);
+  bool IsLayerActive(size_t layer) const;
+
+  void RequestKeyFrame(size_t layer);
+  void RequestKeyFrames();
+
+  // Fills |tasks| with the layers to encode for a frame captured at
+  // |capture_time_ms|, in layer order. Returns the same set as a bit mask.
+  uint32_t Schedule(int64_t capture_time_ms, std::vector<LayerTask>* tasks);
+
+ private:
+  struct Layer {
+    // Minimum spacing of encoded frames, 0 for none.
+    double interval_ms = 0;
+    // Capture time from which the next frame is due.
+    double next_frame_ms = 0;
+    bool has_encoded = false;
+    bool active = true;
+    bool key_frame_pending = true;
+  };
+
+  std::vector<Layer> layers_;
+};
+
+}  // namespace webrtc
+
+#endif  // THIRD_PARTY_H264_WINUWP_UTILS_SIMULCASTLAYERSCHEDULER_H_
@@ -0,0 +1,122 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#include "third_party/winuwp_h264/Utils/SimulcastLayerScheduler.h"
+
+#include <vector>
+#include "test/gtest.h"
+
+namespace webrtc {
+
+namespace {
+
+// Schedules |frames| captured at |fps| starting at |start_ms| and counts
+// the frames each layer encodes.
+std::vector<int> CountFrames(SimulcastLayerScheduler* scheduler,
+                             int frames,
+                             double fps,
+                             int64_t start_ms) {
+  std::vector<int> counts(scheduler->num_layers(), 0);
+  std::vector<SimulcastLayerScheduler::LayerTask> tasks;
+  for (int i = 0; i < frames; ++i) {
+    scheduler->Schedule(start_ms + static_cast<int64_t>(i * 1000 / fps),
+                        &tasks);
+    for (const auto& task : tasks)
+      ++counts[task.layer];
+  }
+  return counts;
+}
+
+}  // namespace
+
+TEST(SimulcastLayerSchedulerTest, AppliesFramerateLimits) {
+  SimulcastLayerScheduler scheduler;
+  scheduler.Configure({15, 30, 0});
+  std::vector<int> counts = CountFrames(&scheduler, 300, 30, 0);
+  EXPECT_NEAR(150, counts[0], 1);
+  EXPECT_EQ(300, counts[1]);
+  EXPECT_EQ(300, counts[2]);
+}
+
+// Capture at 30 fps with jitter of a few ms must not halve a 30 fps layer.
+TEST(SimulcastLayerSchedulerTest, ToleratesCaptureJitter) {
+  SimulcastLayerScheduler scheduler;
+  scheduler.Configure({30});
+  std::vector<SimulcastLayerScheduler::LayerTask> tasks;
+  int encoded = 0;
+  for (int i = 0; i < 300; ++i) {
+    int64_t jitter = (i % 3) * 3 - 3;
+    scheduler.Schedule(i * 1000 / 30 + jitter, &tasks);
+    encoded += static_cast<int>(tasks.size());
+  }
+  EXPECT_GE(encoded, 295);
+}
+
+TEST(SimulcastLayerSchedulerTest, DoesNotCatchUpAfterGap) {
+  SimulcastLayerScheduler scheduler;
+  scheduler.Configure({10});
+  std::vector<SimulcastLayerScheduler::LayerTask> tasks;
+  EXPECT_EQ(1u, scheduler.Schedule(0, &tasks));
+  // Nothing captured for a second, then 30 fps again.
+  EXPECT_EQ(1u, scheduler.Schedule(1000, &tasks));
+  EXPECT_EQ(0u, scheduler.Schedule(1033, &tasks));
+  EXPECT_EQ(0u, scheduler.Schedule(1066, &tasks));
+  EXPECT_EQ(1u, scheduler.Schedule(1100, &tasks));
+}
+
+TEST(SimulcastLayerSchedulerTest, KeyFramesStayPendingUntilEncoded) {
+  SimulcastLayerScheduler scheduler;
+  scheduler.Configure({0, 10});
+  std::vector<SimulcastLayerScheduler::LayerTask> tasks;
+
+  // Every layer starts with a key frame.
+  EXPECT_EQ(3u, scheduler.Schedule(0, &tasks));
+  ASSERT_EQ(2u, tasks.size());
+  EXPECT_TRUE(tasks[0].key_frame);
+  EXPECT_TRUE(tasks[1].key_frame);
+
+  scheduler.RequestKeyFrame(1);
+  // Layer 1 isn't due yet, its request waits.
+  EXPECT_EQ(1u, scheduler.Schedule(33, &tasks));
+  EXPECT_FALSE(tasks[0].key_frame);
+  EXPECT_EQ(3u, scheduler.Schedule(100, &tasks));
+  EXPECT_FALSE(tasks[0].key_frame);
+  EXPECT_TRUE(tasks[1].key_frame);
+
+  scheduler.RequestKeyFrames();
+  scheduler.Schedule(200, &tasks);
+  ASSERT_EQ(2u, tasks.size());
+  EXPECT_TRUE(tasks[0].key_frame);
+  EXPECT_TRUE(tasks[1].key_frame);
+}
+
+TEST(SimulcastLayerSchedulerTest, PausedLayerResumesWithKeyFrame) {
+  SimulcastLayerScheduler scheduler;
+  scheduler.Configure({0, 0});
+  std::vector<SimulcastLayerScheduler::LayerTask> tasks;
+  scheduler.Schedule(0, &tasks);
+
+  scheduler.SetLayerActive(1, false);
+  EXPECT_FALSE(scheduler.IsLayerActive(1));
+  EXPECT_EQ(1u, scheduler.Schedule(33, &tasks));
+
+  scheduler.SetLayerActive(1, true);
+  EXPECT_EQ(3u, scheduler.Schedule(66, &tasks));
+  ASSERT_EQ(2u, tasks.size());
+  EXPECT_FALSE(tasks[0].key_frame);
+  EXPECT_TRUE(tasks[1].key_frame);
+
+  // Out of range layers are ignored.
+  scheduler.SetLayerActive(5, false);
+  scheduler.RequestKeyFrame(5);
+  EXPECT_FALSE(scheduler.IsLayerActive(5));
+}
+
+}  // namespace webrtc
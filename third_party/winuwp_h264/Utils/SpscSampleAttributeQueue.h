@@ -0,0 +1,97 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#ifndef THIRD_PARTY_H264_WINUWP_UTILS_SPSCSAMPLEATTRIBUTEQUEUE_H_
+#define THIRD_PARTY_H264_WINUWP_UTILS_SPSCSAMPLEATTRIBUTEQUEUE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// Fixed-capacity, lock-free variant of SampleAttributeQueue for exactly one
+// producer thread (push) and one consumer thread (pop). Storage is part of
+// the object, so nothing is allocated after construction.
+// The ids have to be in increasing order.
+template <typename T, size_t Capacity>
+class SpscSampleAttributeQueue {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two");
+
+ public:
+  SpscSampleAttributeQueue() : _head(0), _tail(0) {}
+  ~SpscSampleAttributeQueue() {}
+
+  // Producer only. Returns false, dropping |t|, when the queue is full.
+  bool push(uint64_t id, const T& t) {
+    const size_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail - _head.load(std::memory_order_acquire) == Capacity) {
+      return false;
+    }
+    Entry& entry = _entries[tail & (Capacity - 1)];
+    entry.id = id;
+    entry.value = t;
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only. Same semantics as SampleAttributeQueue::pop(): entries
+  // older than |id| are dropped, an exact match is returned and removed,
+  // and a newer entry is returned but kept for its own sample.
+  bool pop(uint64_t id, T& outT) {
+    size_t head = _head.load(std::memory_order_relaxed);
+    const size_t tail = _tail.load(std::memory_order_acquire);
+    bool found = false;
+    while (head != tail) {
+      const Entry& entry = _entries[head & (Capacity - 1)];
+      if (entry.id > id) {
+        outT = entry.value;
+        found = true;
+        break;
+      } else if (entry.id == id) {
+        outT = entry.value;
+        ++head;
+        found = true;
+        break;
+      } else {
+        ++head;
+      }
+    }
+    _head.store(head, std::memory_order_release);
+    return found;
+  }
+
+  // Must not run concurrently with pop().
+  void clear() {
+    _head.store(_tail.load(std::memory_order_acquire),
+                std::memory_order_release);
+  }
+
+  // Safe from either thread; may be stale by the time it returns.
+  uint32_t size() const {
+    const size_t head = _head.load(std::memory_order_acquire);
+    const size_t tail = _tail.load(std::memory_order_acquire);
+    return static_cast<uint32_t>(tail - head);
+  }
+
+  static constexpr size_t capacity() { return Capacity; }
+
+ private:
+  struct Entry {
+    uint64_t id;
+    T value;
+  };
+
+  // Producer and consumer indices live on separate cache lines.
+  alignas(64) std::atomic<size_t> _head;
+  alignas(64) std::atomic<size_t> _tail;
+  Entry _entries[Capacity];
+};
+
+#endif  // THIRD_PARTY_H264_WINUWP_UTILS_SPSCSAMPLEATTRIBUTEQUEUE_H_
@@ -0,0 +1,139 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#include "third_party/winuwp_h264/Utils/SpscSampleAttributeQueue.h"
+
+#include <stdio.h>
+#include <thread>
+#include "rtc_base/timeutils.h"
+#include "test/gtest.h"
+#include "third_party/winuwp_h264/Utils/SampleAttributeQueue.h"
+
+namespace {
+
+// Large enough that a torn read would show up as a mismatch.
+struct Attributes {
+  uint64_t a;
+  uint64_t b;
+  uint64_t c;
+};
+
+Attributes MakeAttributes(uint64_t id) {
+  Attributes attributes = {id, id * 3, ~id};
+  return attributes;
+}
+
+// Both queues run the encoder's pattern: the producer pushes one entry per
+// frame, the consumer pops it by id. Yields while the other side catches
+// up so the test doesn't hang on a single core.
+template <typename Queue>
+int64_t RunProducerConsumer(Queue* queue, uint64_t count) {
+  int64_t start_ns = rtc::TimeNanos();
+  std::thread producer([queue, count] {
+    for (uint64_t id = 1; id <= count; ++id) {
+      while (queue->size() >= 8)
+        std::this_thread::yield();
+      queue->push(id, MakeAttributes(id));
+    }
+  });
+
+  uint64_t mismatches = 0;
+  for (uint64_t id = 1; id <= count; ++id) {
+    Attributes attributes;
+    while (!queue->pop(id, attributes))
+      std::this_thread::yield();
+    if (attributes.a != id || attributes.b != id * 3 || attributes.c != ~id)
+      ++mismatches;
+  }
+  producer.join();
+  EXPECT_EQ(0u, mismatches);
+  return rtc::TimeNanos() - start_ns;
+}
+
+}  // namespace
+
+TEST(SpscSampleAttributeQueueTest, PopMatchesSampleAttributeQueue) {
+  SpscSampleAttributeQueue<int, 8> queue;
+  EXPECT_EQ(8u, queue.capacity());
+  queue.push(10, 1);
+  queue.push(20, 2);
+  queue.push(30, 3);
+
+  int value = 0;
+  // Exact match is returned and removed.
+  EXPECT_TRUE(queue.pop(10, value));
+  EXPECT_EQ(1, value);
+  EXPECT_EQ(2u, queue.size());
+  // A newer entry is returned but kept.
+  EXPECT_TRUE(queue.pop(15, value));
+  EXPECT_EQ(2, value);
+  EXPECT_EQ(2u, queue.size());
+  // Older entries are dropped on the way.
+  EXPECT_TRUE(queue.pop(30, value));
+  EXPECT_EQ(3, value);
+  EXPECT_EQ(0u, queue.size());
+  EXPECT_FALSE(queue.pop(40, value));
+}
+
+TEST(SpscSampleAttributeQueueTest, PushFailsWhenFull) {
+  SpscSampleAttributeQueue<int, 4> queue;
+  for (int i = 0; i < 4; ++i)
+    EXPECT_TRUE(queue.push(i, i));
+  EXPECT_FALSE(queue.push(4, 4));
+  EXPECT_EQ(4u, queue.size());
+
+  int value = 0;
+  EXPECT_TRUE(queue.pop(0, value));
+  EXPECT_TRUE(queue.push(4, 4));
+  queue.clear();
+  EXPECT_EQ(0u, queue.size());
+  EXPECT_FALSE(queue.pop(4, value));
+}
+
+TEST(SpscSampleAttributeQueueTest, ProducerConsumerStress) {
+  SpscSampleAttributeQueue<Attributes, 8> queue;
+  RunProducerConsumer(&queue, 200000);
+  EXPECT_EQ(0u, queue.size());
+}
+
+// Not a pass/fail test: prints the cost per frame of the lock-free queue
+// and of the locked SampleAttributeQueue it replaced, single threaded and
+// with the producer and consumer on two threads.
+TEST(SpscSampleAttributeQueueTest, CompareWithLockedQueue) {
+  const uint64_t kCount = 1000000;
+  SpscSampleAttributeQueue<Attributes, 8> spsc;
+  SampleAttributeQueue<Attributes> locked;
+  Attributes attributes;
+
+  int64_t start_ns = rtc::TimeNanos();
+  for (uint64_t id = 1; id <= kCount; ++id) {
+    spsc.push(id, MakeAttributes(id));
+    spsc.pop(id, attributes);
+  }
+  int64_t spsc_ns = rtc::TimeNanos() - start_ns;
+
+  start_ns = rtc::TimeNanos();
+  for (uint64_t id = 1; id <= kCount; ++id) {
+    locked.push(id, MakeAttributes(id));
+    locked.pop(id, attributes);
+  }
+  int64_t locked_ns = rtc::TimeNanos() - start_ns;
+
+  printf("Single thread push+pop: spsc %.1f ns, locked %.1f ns\n",
+         static_cast<double>(spsc_ns) / kCount,
+         static_cast<double>(locked_ns) / kCount);
+
+  const uint64_t kThreadedCount = 200000;
+  spsc_ns = RunProducerConsumer(&spsc, kThreadedCount);
+  locked_ns = RunProducerConsumer(&locked, kThreadedCount);
+  printf("Two threads per frame: spsc %.1f ns, locked %.1f ns\n",
+         static_cast<double>(spsc_ns) / kThreadedCount,
+         static_cast<double>(locked_ns) / kThreadedCount);
+}
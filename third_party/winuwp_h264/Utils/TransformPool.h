@@ -0,0 +1,157 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#ifndef THIRD_PARTY_H264_WINUWP_UTILS_TRANSFORMPOOL_H_
+#define THIRD_PARTY_H264_WINUWP_UTILS_TRANSFORMPOOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+#include <utility>
+
+namespace webrtc {
+
+// Creates and recycles the transforms a TransformPool leases out.
+// |TransformPtr| is a reference counted handle (ComPtr<IMFTransform> on
+// Windows).
+template <typename TransformPtr>
+class TransformAllocator {
+ public:
+  virtual ~TransformAllocator() {}
+
+  // Returns a ready to configure transform, or a null handle.
+  virtual TransformPtr Create() = 0;
+
+  // Brings a returned transform back to its freshly created state. False
+  // when the transform is unusable and must be discarded.
+  virtual bool Reset(const TransformPtr& transform) = 0;
+};
+
+// Keeps a bounded number of warm transforms so a new stream doesn't pay
+// for creating one. Transforms are leased out and explicitly returned;
+// the most recently returned one is leased first and the longest idle
+// ones are evicted first. Not thread safe.
+template <typename TransformPtr>
+class TransformPool {
+ public:
+  struct Config {
+    // Idle transforms kept warm.
+    size_t max_idle = 4;
+    // Transforms created up front by Prewarm().
+    size_t prewarm = 0;
+    // Idle transforms older than this are dropped, 0 keeps them forever.
+    int64_t idle_timeout_ms = 60000;
+  };
+
+  struct Stats {
+    // Lease() calls, and how many of them a warm transform served.
+    uint64_t leases = 0;
+    uint64_t warm_leases = 0;
+    // Transforms created, including failed attempts.
+    uint64_t creates = 0;
+    uint64_t returns = 0;
+    // Returned transforms that failed to reset.
+    uint64_t discards = 0;
+    // Idle transforms dropped for space or age.
+    uint64_t evictions = 0;
+  };
+
+  TransformPool(TransformAllocator<TransformPtr>* allocator,
+                const Config& config)
+      : allocator_(allocator), config_(config) {}
+
+  // Creates transforms until |config.prewarm| are idle.
+  void Prewarm(int64_t now_ms) {
+    while (idle_.size() < config_.prewarm &&
+           idle_.size() < config_.max_idle) {
+      ++stats_.creates;
+      TransformPtr transform = allocator_->Create();
+      if (!transform)
+        return;
+      idle_.push_back(IdleTransform(std::move(transform), now_ms));
+    }
+  }
+
+  // Returns a warm transform if there is one, a new one otherwise. A null
+  // handle means creation failed.
+  TransformPtr Lease(int64_t now_ms) {
+    EvictExpired(now_ms);
+    ++stats_.leases;
+    if (!idle_.empty()) {
+      TransformPtr transform = std::move(idle_.back().first);
+      idle_.pop_back();
+      ++stats_.warm_leases;
+      ++leased_;
+      return transform;
+    }
+
+    ++stats_.creates;
+    TransformPtr transform = allocator_->Create();
+    if (transform)
+      ++leased_;
+    return transform;
+  }
+
+  // Gives a leased transform back. Null handles are accepted and ignored
+  // so callers don't have to track whether a lease succeeded.
+  void Return(TransformPtr transform, int64_t now_ms) {
+    if (!transform)
+      return;
+    if (leased_ > 0)
+      --leased_;
+    ++stats_.returns;
+    if (!allocator_->Reset(transform)) {
+      ++stats_.discards;
+      return;
+    }
+
+    EvictExpired(now_ms);
+    if (config_.max_idle == 0)
+      return;
+    if (idle_.size() >= config_.max_idle) {
+      idle_.pop_front();
+      ++stats_.evictions;
+    }
+    idle_.push_back(IdleTransform(std::move(transform), now_ms));
+  }
+
+  // Drops idle transforms that exceeded |config.idle_timeout_ms|.
+  void EvictExpired(int64_t now_ms) {
+    if (config_.idle_timeout_ms <= 0)
+      return;
+    while (!idle_.empty() &&
+           now_ms - idle_.front().second >= config_.idle_timeout_ms) {
+      idle_.pop_front();
+      ++stats_.evictions;
+    }
+  }
+
+  // Drops all idle transforms. Leased ones are unaffected.
+  void Clear() { idle_.clear(); }
+
+  size_t idle() const { return idle_.size(); }
+  size_t leased() const { return leased_; }
+  const Config& config() const { return config_; }
+  const Stats& stats() const { return stats_; }
+
+ private:
+  // Transform and the time it went idle, oldest first.
+  typedef std::pair<TransformPtr, int64_t> IdleTransform;
+
+  TransformAllocator<TransformPtr>* const allocator_;
+  const Config config_;
+  std::deque<IdleTransform> idle_;
+  size_t leased_ = 0;
+  Stats stats_;
+};
+
+}  // namespace webrtc
+
+#endif  // THIRD_PARTY_H264_WINUWP_UTILS_TRANSFORMPOOL_H_
@@ -0,0 +1,218 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#include "third_party/winuwp_h264/Utils/TransformPool.h"
+
+#include <stdio.h>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include "rtc_base/timeutils.h"
+#include "test/gtest.h"
+
+namespace webrtc {
+
+namespace {
+
+// Stands in for the decoder MFT: records whether it was configured for a
+// stream and how often it was reset.
+struct StubTransform {
+  explicit StubTransform(int id) : id(id) {}
+  int id;
+  bool configured = false;
+  int resets = 0;
+};
+
+typedef std::shared_ptr<StubTransform> StubTransformPtr;
+
+class StubAllocator : public TransformAllocator<StubTransformPtr> {
+ public:
+  StubTransformPtr Create() override {
+    ++creates;
+    if (create_delay_ms > 0)
+      std::this_thread::sleep_for(std::chrono::milliseconds(create_delay_ms));
+    if (fail_creates)
+      return nullptr;
+    return std::make_shared<StubTransform>(creates);
+  }
+
+  bool Reset(const StubTransformPtr& transform) override {
+    ++transform->resets;
+    transform->configured = false;
+    return !fail_resets;
+  }
+
+  int creates = 0;
+  int create_delay_ms = 0;
+  bool fail_creates = false;
+  bool fail_resets = false;
+};
+
+typedef TransformPool<StubTransformPtr> StubPool;
+
+StubPool::Config PoolConfig(size_t max_idle, int64_t idle_timeout_ms) {
+  StubPool::Config config;
+  config.max_idle = max_idle;
+  config.idle_timeout_ms = idle_timeout_ms;
+  return config;
+}
+
+}  // namespace
+
+TEST(TransformPoolTest, LeaseCreatesWhenEmpty) {
+  StubAllocator allocator;
+  StubPool pool(&allocator, PoolConfig(2, 0));
+  StubTransformPtr transform = pool.Lease(0);
+  ASSERT_TRUE(transform);
+  EXPECT_EQ(1, allocator.creates);
+  EXPECT_EQ(1u, pool.leased());
+  EXPECT_EQ(0u, pool.idle());
+  EXPECT_EQ(1u, pool.stats().leases);
+  EXPECT_EQ(0u, pool.stats().warm_leases);
+}
+
+TEST(TransformPoolTest, ReturnedTransformIsResetAndReused) {
+  StubAllocator allocator;
+  StubPool pool(&allocator, PoolConfig(2, 0));
+  StubTransformPtr transform = pool.Lease(0);
+  transform->configured = true;
+  StubTransform* raw = transform.get();
+  pool.Return(std::move(transform), 10);
+  EXPECT_EQ(0u, pool.leased());
+  EXPECT_EQ(1u, pool.idle());
+  EXPECT_FALSE(raw->configured);
+  EXPECT_EQ(1, raw->resets);
+
+  transform = pool.Lease(20);
+  EXPECT_EQ(raw, transform.get());
+  EXPECT_EQ(1, allocator.creates);
+  EXPECT_EQ(1u, pool.stats().warm_leases);
+}
+
+TEST(TransformPoolTest, MostRecentlyReturnedIsLeasedFirst) {
+  StubAllocator allocator;
+  StubPool pool(&allocator, PoolConfig(4, 0));
+  StubTransformPtr a = pool.Lease(0);
+  StubTransformPtr b = pool.Lease(0);
+  pool.Return(a, 1);
+  pool.Return(b, 2);
+  EXPECT_EQ(b, pool.Lease(3));
+  EXPECT_EQ(a, pool.Lease(3));
+}
+
+TEST(TransformPoolTest, FullPoolEvictsLongestIdle) {
+  StubAllocator allocator;
+  StubPool pool(&allocator, PoolConfig(2, 0));
+  StubTransformPtr a = pool.Lease(0);
+  StubTransformPtr b = pool.Lease(0);
+  StubTransformPtr c = pool.Lease(0);
+  std::weak_ptr<StubTransform> a_ref = a;
+  pool.Return(std::move(a), 1);
+  pool.Return(b, 2);
+  pool.Return(c, 3);
+  EXPECT_TRUE(a_ref.expired());
+  EXPECT_EQ(2u, pool.idle());
+  EXPECT_EQ(1u, pool.stats().evictions);
+  EXPECT_EQ(c, pool.Lease(4));
+  EXPECT_EQ(b, pool.Lease(4));
+}
+
+TEST(TransformPoolTest, IdleTimeoutEvicts) {
+  StubAllocator allocator;
+  StubPool pool(&allocator, PoolConfig(4, 1000));
+  StubTransformPtr a = pool.Lease(0);
+  StubTransformPtr b = pool.Lease(0);
+  pool.Return(a, 0);
+  pool.Return(b, 500);
+
+  pool.EvictExpired(999);
+  EXPECT_EQ(2u, pool.idle());
+  pool.EvictExpired(1000);
+  EXPECT_EQ(1u, pool.idle());
+  EXPECT_EQ(1u, pool.stats().evictions);
+
+  // Lease() evicts first, so the expired one isn't handed out.
+  StubTransformPtr fresh = pool.Lease(1500);
+  EXPECT_NE(b, fresh);
+  EXPECT_EQ(0u, pool.idle());
+  EXPECT_EQ(2u, pool.stats().evictions);
+  EXPECT_EQ(3, allocator.creates);
+}
+
+TEST(TransformPoolTest, FailedResetDiscards) {
+  StubAllocator allocator;
+  StubPool pool(&allocator, PoolConfig(2, 0));
+  StubTransformPtr transform = pool.Lease(0);
+  allocator.fail_resets = true;
+  pool.Return(std::move(transform), 1);
+  EXPECT_EQ(0u, pool.idle());
+  EXPECT_EQ(0u, pool.leased());
+  EXPECT_EQ(1u, pool.stats().discards);
+}
+
+TEST(TransformPoolTest, FailedCreateIsNotLeased) {
+  StubAllocator allocator;
+  allocator.fail_creates = true;
+  StubPool pool(&allocator, PoolConfig(2, 0));
+  EXPECT_FALSE(pool.Lease(0));
+  EXPECT_EQ(0u, pool.leased());
+  EXPECT_EQ(1u, pool.stats().creates);
+  // Returning the null handle is a no-op.
+  pool.Return(nullptr, 1);
+  EXPECT_EQ(0u, pool.stats().returns);
+}
+
+TEST(TransformPoolTest, PrewarmFillsUpToLimit) {
+  StubAllocator allocator;
+  StubPool::Config config = PoolConfig(2, 0);
+  config.prewarm = 3;
+  StubPool pool(&allocator, config);
+  pool.Prewarm(0);
+  EXPECT_EQ(2u, pool.idle());
+  EXPECT_EQ(2, allocator.creates);
+  pool.Lease(1);
+  EXPECT_EQ(1u, pool.stats().warm_leases);
+}
+
+TEST(TransformPoolTest, ZeroMaxIdleKeepsNothing) {
+  StubAllocator allocator;
+  StubPool pool(&allocator, PoolConfig(0, 0));
+  pool.Return(pool.Lease(0), 1);
+  EXPECT_EQ(0u, pool.idle());
+  EXPECT_EQ(1u, pool.stats().returns);
+}
+
+// Not a pass/fail test: a stream start and stop with a cold and with a
+// warm pool. The stub's Create() sleeps in place of creating the decoder
+// MFT, so this shows what the pool saves, not what the real MFT costs.
+TEST(TransformPoolTest, StreamCreateDestroyTiming) {
+  const int kStreams = 20;
+  StubAllocator allocator;
+  allocator.create_delay_ms = 5;
+
+  StubPool cold(&allocator, PoolConfig(0, 0));
+  int64_t start_us = rtc::TimeMicros();
+  for (int i = 0; i < kStreams; ++i)
+    cold.Return(cold.Lease(i), i);
+  int64_t cold_us = rtc::TimeMicros() - start_us;
+
+  StubPool warm(&allocator, PoolConfig(1, 0));
+  start_us = rtc::TimeMicros();
+  for (int i = 0; i < kStreams; ++i)
+    warm.Return(warm.Lease(i), i);
+  int64_t warm_us = rtc::TimeMicros() - start_us;
+
+  EXPECT_EQ(static_cast<uint64_t>(kStreams - 1), warm.stats().warm_leases);
+  printf("Stream start/stop: %.0f us without pool, %.0f us with pool\n",
+         static_cast<double>(cold_us) / kStreams,
+         static_cast<double>(warm_us) / kStreams);
+}
+
+}  // namespace webrtc
@@ -0,0 +1,100 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#include "third_party/winuwp_h264/Utils/WorkerPool.h"
+
+#include <atomic>
+
+namespace webrtc {
+
+// One ParallelFor() call. Workers keep a reference, so one that wakes up
+// late finds the job exhausted instead of a dangling task.
+struct WorkerPool::Job {
+  Job(const std::function<void(size_t)>* task, size_t count)
+      : task(task), count(count), next(0), finished(0) {}
+
+  const std::function<void(size_t)>* const task;
+  const size_t count;
+  std::atomic<size_t> next;
+  std::atomic<size_t> finished;
+};
+
+WorkerPool::WorkerPool(size_t num_threads) {
+  threads_.reserve(num_threads);
+  for (size_t i = 0; i < num_threads; ++i)
+    threads_.emplace_back([this] { RunWorker(); });
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (std::thread& thread : threads_)
+    thread.join();
+}
+
+void WorkerPool::ParallelFor(size_t count,
+                             const std::function<void(size_t)>& task) {
+  if (threads_.empty() || count <= 1) {
+    for (size_t i = 0; i < count; ++i)
+      task(i);
+    return;
+  }
+
+  std::lock_guard<std::mutex> run_lock(run_mutex_);
+  std::shared_ptr<Job> job = std::make_shared<Job>(&task, count);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    job_ = job;
+    ++generation_;
+  }
+  wake_.notify_all();
+
+  RunTasks(job.get());
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [&job] { return job->finished == job->count; });
+  job_.reset();
+}
+
+void WorkerPool::RunWorker() {
+  uint64_t seen_generation = 0;
+  while (true) {
+    std::shared_ptr<Job> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [this, seen_generation] {
+        return stop_ || generation_ != seen_generation;
+      });
+      if (stop_)
+        return;
+      seen_generation = generation_;
+      job = job_;
+    }
+    if (job)
+      RunTasks(job.get());
+  }
+}
+
+void WorkerPool::RunTasks(Job* job) {
+  size_t i;
+  while ((i = job->next.fetch_add(1)) < job->count) {
+    (*job->task)(i);
+    if (job->finished.fetch_add(1) + 1 == job->count) {
+      // Taking the lock orders this with the waiter's predicate check.
+      std::lock_guard<std::mutex> lock(mutex_);
+      done_.notify_all();
+    }
+  }
+}
+
+}  // namespace webrtc
@@ -0,0 +1,65 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#ifndef THIRD_PARTY_H264_WINUWP_UTILS_WORKERPOOL_H_
+#define THIRD_PARTY_H264_WINUWP_UTILS_WORKERPOOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace webrtc {
+
+// A fixed set of threads started once and kept for the pool's lifetime,
+// for per-frame work that is split into a few parallel tasks. Starting a
+// thread per task costs more than a 1080p slice conversion takes.
+class WorkerPool {
+ public:
+  // Starts |num_threads| threads; 0 runs everything on the caller.
+  explicit WorkerPool(size_t num_threads);
+  ~WorkerPool();
+
+  size_t num_threads() const { return threads_.size(); }
+
+  // Runs |task(i)| for every i in [0, count) and returns once all of them
+  // are done. The calling thread runs tasks too. Concurrent calls are
+  // serialized.
+  void ParallelFor(size_t count, const std::function<void(size_t)>& task);
+
+ private:
+  struct Job;
+
+  void RunWorker();
+  void RunTasks(Job* job);
+
+  // Held for a whole ParallelFor() call.
+  std::mutex run_mutex_;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  std::shared_ptr<Job> job_;
+  uint64_t generation_ = 0;
+  bool stop_ = false;
+
+  std::vector<std::thread> threads_;
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+};
+
+}  // namespace webrtc
+
+#endif  // THIRD_PARTY_H264_WINUWP_UTILS_WORKERPOOL_H_
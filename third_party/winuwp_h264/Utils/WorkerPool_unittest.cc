@@ -0,0 +1,76 @@
+/*
+*  Copyright (c) 2015 The WebRTC project authors. All Rights Reserved.
+*
+*  Use of this source code is governed by a BSD-style license
+*  that can be found in the LICENSE file in the root of the source
+*  tree. An additional intellectual property rights grant can be found
+*  in the file PATENTS.  All contributing project authors may
+*  be found in the AUTHORS file in the root of the source tree.
+*/
+
+#include "third_party/winuwp_h264/Utils/WorkerPool.h"
+
+#include <atomic>
+#include <set>
+#include <thread>
+#include <vector>
+#include "test/gtest.h"
+
+namespace webrtc {
+
+TEST(WorkerPoolTest, RunsEveryTaskOnce) {
+  WorkerPool pool(3);
+  EXPECT_EQ(3u, pool.num_threads());
+  for (size_t count = 0; count < 20; ++count) {
+    std::vector<std::atomic<int>> runs(count);
+    for (auto& run : runs)
+      run = 0;
+    pool.ParallelFor(count, [&runs](size_t i) { ++runs[i]; });
+    for (size_t i = 0; i < count; ++i)
+      EXPECT_EQ(1, runs[i]) << i;
+  }
+}
+
+TEST(WorkerPoolTest, WithoutThreadsRunsOnCaller) {
+  WorkerPool pool(0);
+  const std::thread::id caller = std::this_thread::get_id();
+  int runs = 0;
+  pool.ParallelFor(5, [&](size_t i) {
+    EXPECT_EQ(caller, std::this_thread::get_id());
+    ++runs;
+  });
+  EXPECT_EQ(5, runs);
+}
+
+TEST(WorkerPoolTest, UsesWorkerThreads) {
+  WorkerPool pool(2);
+  std::atomic<int> arrived(0);
+  std::mutex mutex;
+  std::set<std::thread::id> threads;
+  // Every task waits for the others, so all three threads must take one.
+  pool.ParallelFor(3, [&](size_t i) {
+    ++arrived;
+    while (arrived < 3)
+      std::this_thread::yield();
+    std::lock_guard<std::mutex> lock(mutex);
+    threads.insert(std::this_thread::get_id());
+  });
+  EXPECT_EQ(3u, threads.size());
+}
+
+TEST(WorkerPoolTest, ConcurrentCallersAreSerialized) {
+  WorkerPool pool(2);
+  std::atomic<int> total(0);
+  std::vector<std::thread> callers;
+  for (int c = 0; c < 4; ++c) {
+    callers.emplace_back([&pool, &total] {
+      for (int round = 0; round < 500; ++round)
+        pool.ParallelFor(4, [&total](size_t i) { ++total; });
+    });
+  }
+  for (std::thread& caller : callers)
+    caller.join();
+  EXPECT_EQ(4 * 500 * 4, total);
+}
+
+}  // namespace webrtc
@@ -11,11 +11,15 @@
 #ifndef THIRD_PARTY_H264_WINUWP_NATIVE_FRAME_H_
 #define THIRD_PARTY_H264_WINUWP_NATIVE_FRAME_H_
 
+#include "api/video/i420_buffer.h"
 #include "api/video/video_frame_buffer.h"
 #include "media/base/videocommon.h"
+#include "third_party/winuwp_h264/Utils/NV12Conversion.h"
 
 namespace webrtc {
 
+class NV12NativeBuffer;
+
 class NativeHandleBuffer : public VideoFrameBuffer {
  public:
   NativeHandleBuffer(void* native_handle, int width, int height)
@@ -40,11 +44,74 @@ class NativeHandleBuffer : public VideoFrameBuffer {
 
   virtual cricket::FourCC fourCC() const = 0;
 
+  // Non-null when the pixels can be read directly as NV12 planes.
+  virtual const NV12NativeBuffer* AsNV12() const {
+    return nullptr;
+  }
+
  protected:
   void* native_handle_;
   const int width_;
   const int height_;
 };
+
+// NV12 image living in memory owned by a subclass (e.g. a locked Media
+// Foundation buffer), so it can travel through the pipeline without being
+// converted to I420. Strides may be larger than the width.
+class NV12NativeBuffer : public NativeHandleBuffer {
+ public:
+  NV12NativeBuffer(void* native_handle, int width, int height,
+                   const uint8_t* data_y, int stride_y,
+                   const uint8_t* data_uv, int stride_uv)
+    : NativeHandleBuffer(native_handle, width, height),
+    data_y_(data_y),
+    stride_y_(stride_y),
+    data_uv_(data_uv),
+    stride_uv_(stride_uv) { }
+
+  cricket::FourCC fourCC() const override {
+    return cricket::FOURCC_NV12;
+  }
+
+  const NV12NativeBuffer* AsNV12() const override {
+    return this;
+  }
+
+  const uint8_t* DataY() const {
+    return data_y_;
+  }
+  int StrideY() const {
+    return stride_y_;
+  }
+  const uint8_t* DataUV() const {
+    return data_uv_;
+  }
+  int StrideUV() const {
+    return stride_uv_;
+  }
+
+  ConstNV12Planes planes() const {
+    ConstNV12Planes planes = { data_y_, stride_y_, data_uv_, stride_uv_ };
+    return planes;
+  }
+
+  // Any thread may call this, so the conversion runs on the caller.
+  rtc::scoped_refptr<I420BufferInterface> ToI420() override {
+    rtc::scoped_refptr<I420Buffer> buffer = I420Buffer::Create(width_, height_);
+    ConvertNV12ToI420(planes(),
+      buffer->MutableDataY(), buffer->StrideY(),
+      buffer->MutableDataU(), buffer->StrideU(),
+      buffer->MutableDataV(), buffer->StrideV(),
+      width_, height_, nullptr);
+    return buffer;
+  }
+
+ protected:
+  const uint8_t* const data_y_;
+  const int stride_y_;
+  const uint8_t* const data_uv_;
+  const int stride_uv_;
+};
 }  // namespace webrtc
 
 #endif  // THIRD_PARTY_H264_WINUWP_NATIVE_FRAME_H_
@@ -11,14 +11,20 @@
 #include <vector>
 #include "third_party/winuwp_h264/winuwp_h264_factory.h"
 #include "third_party/winuwp_h264/H264Encoder/H264Encoder.h"
+#include "third_party/winuwp_h264/H264Encoder/H264SimulcastEncoder.h"
 #include "third_party/winuwp_h264/H264Decoder/H264Decoder.h"
 #include "media/engine/webrtcvideoencoderfactory.h"
 #include "media/engine/webrtcvideodecoderfactory.h"
+#include "rtc_base/timeutils.h"
 
 
 namespace webrtc {
 
-  WinUWPH264EncoderFactory::WinUWPH264EncoderFactory() {
+  WinUWPH264EncoderFactory::WinUWPH264EncoderFactory()
+    : WinUWPH264EncoderFactory(false) {}
+
+  WinUWPH264EncoderFactory::WinUWPH264EncoderFactory(bool copyOutputBuffers)
+    : copyOutputBuffers_(copyOutputBuffers) {
     codecList_ =
       std::vector<cricket::VideoCodec> {
         cricket::VideoCodec("H264")
@@ -28,7 +34,9 @@ namespace webrtc {
   webrtc::VideoEncoder* WinUWPH264EncoderFactory::CreateVideoEncoder(
     const cricket::VideoCodec& codec) {
     if (codec.name == "H264") {
-      return new WinUWPH264EncoderImpl();
+      // The simulcast streams are only known at InitEncode(); with one
+      // stream the adapter passes frames and output straight through.
+      return new WinUWPH264SimulcastEncoder(copyOutputBuffers_);
     } else {
       return nullptr;
     }
@@ -46,10 +54,37 @@ namespace webrtc {
   }
 
 
+  WinUWPH264DecoderFactory::WinUWPH264DecoderFactory()
+    : WinUWPH264DecoderFactory(MFTransformPool::Config()) {}
+
+  WinUWPH264DecoderFactory::WinUWPH264DecoderFactory(
+    const MFTransformPool::Config& config)
+    : transformPool_(&transformAllocator_, config) {
+    if (runtime_.started()) {
+      rtc::CritScope lock(&crit_);
+      transformPool_.Prewarm(rtc::TimeMillis());
+    }
+  }
+
+  WinUWPH264DecoderFactory::~WinUWPH264DecoderFactory() {
+    // Idle transforms must go before |runtime_| shuts MF down.
+    rtc::CritScope lock(&crit_);
+    transformPool_.Clear();
+  }
+
   webrtc::VideoDecoder* WinUWPH264DecoderFactory::CreateVideoDecoder(
     webrtc::VideoCodecType type) {
     if (type == kVideoCodecH264) {
-      return new WinUWPH264DecoderImpl();
+      ComPtr<IMFTransform> transform;
+      if (runtime_.started()) {
+        rtc::CritScope lock(&crit_);
+        transform = transformPool_.Lease(rtc::TimeMillis());
+      }
+      // Without a transform the decoder creates its own in InitDecode().
+      WinUWPH264DecoderImpl* decoder = new WinUWPH264DecoderImpl(transform);
+      rtc::CritScope lock(&crit_);
+      decoders_[decoder] = decoder;
+      return decoder;
     } else {
       return nullptr;
     }
@@ -57,8 +92,33 @@ namespace webrtc {
 
   void WinUWPH264DecoderFactory::DestroyVideoDecoder(
     webrtc::VideoDecoder* decoder) {
+    WinUWPH264DecoderImpl* leased = nullptr;
+    {
+      rtc::CritScope lock(&crit_);
+      auto it = decoders_.find(decoder);
+      if (it != decoders_.end()) {
+        leased = it->second;
+        decoders_.erase(it);
+      }
+    }
+
     decoder->Release();
+    ComPtr<IMFTransform> transform;
+    if (leased != nullptr) {
+      transform = leased->DetachTransform();
+    }
     delete decoder;
+
+    // Release() drops a transform it could not reset.
+    if (transform != nullptr) {
+      rtc::CritScope lock(&crit_);
+      transformPool_.Return(transform, rtc::TimeMillis());
+    }
+  }
+
+  MFTransformPool::Stats WinUWPH264DecoderFactory::GetPoolStats() const {
+    rtc::CritScope lock(&crit_);
+    return transformPool_.stats();
   }
 
 }  // namespace webrtc
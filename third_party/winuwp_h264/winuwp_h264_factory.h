@@ -11,16 +11,24 @@
 #ifndef THIRD_PARTY_H264_WINUWP_H264_WINUWP_FACTORY_H_
 #define THIRD_PARTY_H264_WINUWP_H264_WINUWP_FACTORY_H_
 
+#include <map>
 #include <vector>
 #include "media/engine/webrtcvideoencoderfactory.h"
 #include "media/engine/webrtcvideodecoderfactory.h"
 #include "media/base/codec.h"
+#include "rtc_base/criticalsection.h"
+#include "third_party/winuwp_h264/Utils/MFDecoderTransformAllocator.h"
+#include "third_party/winuwp_h264/Utils/MFRuntimeSession.h"
 
 namespace webrtc {
 
+class WinUWPH264DecoderImpl;
+
 class WinUWPH264EncoderFactory : public cricket::WebRtcVideoEncoderFactory {
  public:
   WinUWPH264EncoderFactory();
+  // See WinUWPH264EncoderImpl for |copyOutputBuffers|.
+  explicit WinUWPH264EncoderFactory(bool copyOutputBuffers);
 
   webrtc::VideoEncoder* CreateVideoEncoder(const cricket::VideoCodec& codec)
     override;
@@ -32,13 +40,33 @@ class WinUWPH264EncoderFactory : public cricket::WebRtcVideoEncoderFactory {
 
  private:
   std::vector<cricket::VideoCodec> codecList_;
+  const bool copyOutputBuffers_;
 };
 
+// Keeps the Media Foundation runtime up for as long as the factory lives
+// and leases decoders a warm transform from a pool, so stream churn in
+// large calls doesn't pay for the decoder cold start every time.
 class WinUWPH264DecoderFactory : public cricket::WebRtcVideoDecoderFactory {
+ public:
+  WinUWPH264DecoderFactory();
+  explicit WinUWPH264DecoderFactory(const MFTransformPool::Config& config);
+  ~WinUWPH264DecoderFactory() override;
+
   webrtc::VideoDecoder* CreateVideoDecoder(webrtc::VideoCodecType type)
     override;
 
   void DestroyVideoDecoder(webrtc::VideoDecoder* decoder) override;
+
+  MFTransformPool::Stats GetPoolStats() const;
+
+ private:
+  MFRuntimeSession runtime_;
+  MFDecoderTransformAllocator transformAllocator_;
+  rtc::CriticalSection crit_;
+  MFTransformPool transformPool_;
+  // Decoders handed out by CreateVideoDecoder(), the only ones whose
+  // transform goes back to |transformPool_|.
+  std::map<webrtc::VideoDecoder*, WinUWPH264DecoderImpl*> decoders_;
 };
 }  // namespace webrtc
 